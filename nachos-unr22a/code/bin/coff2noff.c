@@ -8,6 +8,10 @@
 ///     ld with  -N -T 0
 /// to make sure the object file has no shared text.
 ///
+/// If the COFF file has a symbol table, the address and name of each
+/// procedure in it is also written, one per line, to a symbol map next to
+/// the NOFF file, `<noffFileName>.sym`, for profiling.
+///
 /// Also assumes that the COFF file has at most 3 segments:
 ///    .text      -- read-only executable instructions
 ///    .data      -- initialized data
@@ -80,6 +84,45 @@ WriteOrDie(FILE *f, const char *buffer, size_t numBytes)
     }
 }
 
+/// Write the symbol map of the COFF file `in` for `noffFileName`.
+///
+/// Problems are not fatal: the NOFF file is good without the map.
+static void
+WriteSymbolMap(coffReaderData *d, FILE *in, const char *noffFileName)
+{
+    assert(d != NULL);
+    assert(in != NULL);
+    assert(noffFileName != NULL);
+
+    char *mapFileName = malloc(strlen(noffFileName) + sizeof ".sym");
+    if (mapFileName == NULL) {
+        return;
+    }
+    strcpy(mapFileName, noffFileName);
+    strcat(mapFileName, ".sym");
+    unlink(mapFileName);  // Do not leave the map of an older build.
+
+    char *errorS;
+    coffSymbol *symbols;
+    int n = CoffReaderProcedures(d, in, &symbols, &errorS);
+    if (n < 0) {
+        printf("WARNING: no symbol map: %s.\n", errorS);
+    } else if (n > 0) {
+        FILE *map = fopen(mapFileName, "w");
+        if (map == NULL) {
+            perror(mapFileName);
+        } else {
+            for (int i = 0; i < n; i++) {
+                fprintf(map, "%08X %s\n", symbols[i].value, symbols[i].name);
+            }
+            fclose(map);
+            printf("Wrote %d symbols to %s.\n", n, mapFileName);
+        }
+        CoffReaderFreeSymbols(symbols, n);
+    }
+    free(mapFileName);
+}
+
 void
 main(int argc, char *argv[])
 {
@@ -207,6 +250,7 @@ main(int argc, char *argv[])
 
     fseek(out, 0, SEEK_SET);
     WriteOrDie(out, (const char *) &noffH, sizeof noffH);
+    WriteSymbolMap(&d, in, argv[2]);
     fclose(in);
     fclose(out);
     exit(0);
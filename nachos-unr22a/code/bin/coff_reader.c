@@ -5,8 +5,10 @@
 
 
 #include "coff_reader.h"
+#include "extern/syms.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 /// Routines for converting words and short words to and from the simulated
@@ -121,3 +123,89 @@ CoffReaderNextSection(coffReaderData *d)
     } else
         return &d->sections[d->current++];
 }
+
+static int
+CompareSymbols(const void *a, const void *b)
+{
+    uint32_t va = ((const coffSymbol *) a)->value;
+    uint32_t vb = ((const coffSymbol *) b)->value;
+    return va < vb ? -1 : va > vb;
+}
+
+int
+CoffReaderProcedures(coffReaderData *d, FILE *f, coffSymbol **symbols,
+                     char **error)
+{
+    assert(d != NULL);
+    assert(f != NULL);
+    assert(symbols != NULL);
+
+    *symbols = NULL;
+    uint32_t symbolPtr = WordToHost(d->fileH.symbolPtr);
+    if (symbolPtr == 0) {
+        return 0;
+    }
+
+    HDRR h;
+    if (fseek(f, symbolPtr, SEEK_SET) != 0 || fread(&h, sizeof h, 1, f) != 1) {
+        FAIL(-1, "File is too short");
+    }
+    if ((uint16_t) ShortToHost(h.magic) != magicSym) {
+        FAIL(-1, "Bad symbolic header");
+    }
+    unsigned nExt = WordToHost(h.iextMax);
+    unsigned ssSize = WordToHost(h.issExtMax);
+
+    // External symbols and their string space.
+    EXTR *ext = malloc(nExt * sizeof *ext + 1);
+    char *ss = malloc(ssSize + 1);
+    coffSymbol *procs = malloc(nExt * sizeof *procs + 1);
+    if (ext == NULL || ss == NULL || procs == NULL) {
+        free(ext);
+        free(ss);
+        free(procs);
+        FAIL(-1, "Could not allocate memory");
+    }
+    if (fseek(f, WordToHost(h.cbExtOffset), SEEK_SET) != 0
+          || fread(ext, sizeof *ext, nExt, f) != nExt
+          || fseek(f, WordToHost(h.cbSsExtOffset), SEEK_SET) != 0
+          || fread(ss, 1, ssSize, f) != ssSize) {
+        free(ext);
+        free(ss);
+        free(procs);
+        FAIL(-1, "File is too short");
+    }
+    ss[ssSize] = '\0';
+
+    unsigned n = 0;
+    for (unsigned i = 0; i < nExt; i++) {
+        const SYMR *sym = &ext[i].asym;
+        unsigned iss = WordToHost(sym->iss);
+        if (sym->sc != scText || (sym->st != stProc && sym->st != stStaticProc)
+              || iss >= ssSize) {
+            continue;
+        }
+        procs[n].value = WordToHost(sym->value);
+        procs[n].name = malloc(strlen(&ss[iss]) + 1);
+        if (procs[n].name == NULL) {
+            continue;
+        }
+        strcpy(procs[n].name, &ss[iss]);
+        n++;
+    }
+    free(ext);
+    free(ss);
+
+    qsort(procs, n, sizeof *procs, CompareSymbols);
+    *symbols = procs;
+    return n;
+}
+
+void
+CoffReaderFreeSymbols(coffSymbol *symbols, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++) {
+        free(symbols[i].name);
+    }
+    free(symbols);
+}
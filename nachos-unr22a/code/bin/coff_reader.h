@@ -25,5 +25,20 @@ void CoffReaderUnload(coffReaderData *d);
 
 coffSectionHeader *CoffReaderNextSection(coffReaderData *d);
 
+typedef struct coffSymbol {
+    uint32_t value;  // Address.
+    char *name;
+} coffSymbol;
+
+/// Read the procedures in the external symbol table, sorted by address.
+///
+/// Returns how many there are, 0 if the file has no symbol table (it was
+/// linked with `-s`), or -1 on error.  The array and the names are
+/// allocated with `malloc`; see `CoffReaderFreeSymbols`.
+int CoffReaderProcedures(coffReaderData *d, FILE *f, coffSymbol **symbols,
+                         char **error);
+
+void CoffReaderFreeSymbols(coffSymbol *symbols, unsigned n);
+
 
 #endif
@@ -261,4 +261,10 @@ int
 OpenFile::GetSector()
 {
     return sct;
+}
+
+unsigned
+OpenFile::GetVersion()
+{
+    return hdr->FileLength();
 }
\ No newline at end of file
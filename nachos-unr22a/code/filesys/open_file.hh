@@ -80,7 +80,19 @@ public:
         return SystemDep::Tell(file);
     }
 
-    int GetSector();
+    /// A UNIX file has no header sector; its inode tells it apart from
+    /// the other files the same way.
+    int GetSector()
+    {
+        return SystemDep::Inode(file);
+    }
+
+    /// Changes whenever the file is written, or removed and another one
+    /// takes its inode.
+    unsigned GetVersion()
+    {
+        return SystemDep::Version(file);
+    }
 
 private:
     int file;
@@ -119,6 +131,10 @@ public:
 
     int GetSector();
 
+    /// Changes whenever the length of the file does.  The header keeps no
+    /// time of the last write to tell apart anything finer.
+    unsigned GetVersion();
+
 
   private:
     FileHeader *hdr;  ///< Header for this file.
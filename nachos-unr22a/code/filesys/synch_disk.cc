@@ -78,6 +78,18 @@ SynchDisk::WriteSector(int sectorNumber, const char *data)
     lock->Release();
 }
 
+void
+SynchDisk::ReadSectorUntimed(int sectorNumber, char *data)
+{
+    disk->ReadSectorUntimed(sectorNumber, data);
+}
+
+void
+SynchDisk::WriteSectorUntimed(int sectorNumber, const char *data)
+{
+    disk->WriteSectorUntimed(sectorNumber, data);
+}
+
 /// Disk interrupt handler.  Wake up any thread waiting for the disk
 /// request to finish.
 void
@@ -40,6 +40,12 @@ public:
     void ReadSector(int sectorNumber, char *data);
     void WriteSector(int sectorNumber, const char *data);
 
+    /// Read/write a disk sector outside simulated time, for checkpoints.
+    /// See `Disk::ReadSectorUntimed`.
+
+    void ReadSectorUntimed(int sectorNumber, char *data);
+    void WriteSectorUntimed(int sectorNumber, const char *data);
+
     /// Called by the disk device interrupt handler, to signal that the
     /// current disk operation is complete.
     void RequestDone();
@@ -106,13 +106,29 @@ Console::CheckCharAvail()
     interrupt->Schedule(ConsoleReadPoll, this,
             CONSOLE_TIME, CONSOLE_READ_INT);
 
-    // Do nothing if character is already buffered, or none to be read.
-    if (incoming != EOF || !SystemDep::PollFile(readFileNo)) {
+    // Do nothing if character is already buffered.
+    if (incoming != EOF) {
         return;
     }
 
-    // Otherwise, read character and tell user about it.
-    SystemDep::Read(readFileNo, &c, sizeof c);
+    if (trace != nullptr && trace->IsReplaying()) {
+        // The character, if any, comes from the trace instead.
+        unsigned size = sizeof c;
+        if (!trace->Replay(TRACE_CONSOLE_CHAR, &c, &size)) {
+            return;
+        }
+    } else {
+        // Do nothing if none to be read.
+        if (!SystemDep::PollFile(readFileNo)) {
+            return;
+        }
+        SystemDep::Read(readFileNo, &c, sizeof c);
+        if (trace != nullptr) {
+            trace->Record(TRACE_CONSOLE_CHAR, &c, sizeof c);
+        }
+    }
+
+    // Otherwise, tell user about the character read.
     incoming = c;
     stats->numConsoleCharsRead++;
     (*readHandler)(handlerArg);
@@ -17,6 +17,7 @@
 #include "disk.hh"
 #include "threads/system.hh"
 
+#include <stdint.h>
 #include <stdio.h>
 
 
@@ -36,6 +37,26 @@ DiskDone(void *arg)
     ((Disk *) arg)->HandleInterrupt();
 }
 
+/// Hash the contents of the disk (FNV-1a), so that a replayed run can tell
+/// whether it starts from the same disk as the recorded one.
+static uint64_t
+HashDisk(int fileno)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    char sector[SECTOR_SIZE];
+
+    SystemDep::Lseek(fileno, 0, 0);
+    for (unsigned done = 0; done < DISK_SIZE; done += sizeof sector) {
+        unsigned size = DISK_SIZE - done < sizeof sector ? DISK_SIZE - done
+                                                         : sizeof sector;
+        SystemDep::Read(fileno, sector, size);
+        for (unsigned i = 0; i < size; i++) {
+            hash = (hash ^ (unsigned char) sector[i]) * 0x100000001B3;
+        }
+    }
+    return hash;
+}
+
 /// Initialize a simulated disk.  Open the UNIX file (creating it if it
 /// does not exist), and check the magic number to make sure it is ok to
 /// treat it as Nachos disk storage.
@@ -73,6 +94,17 @@ Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
         SystemDep::WriteFile(fileno, (char *) &tmp, sizeof (int));
     }
     active = false;
+
+    if (trace != nullptr) {
+        uint64_t hash = HashDisk(fileno), recorded;
+        unsigned size = sizeof recorded;
+        if (!trace->IsReplaying()) {
+            trace->Record(TRACE_DISK_HASH, (char *) &hash, sizeof hash);
+        } else if (!trace->Replay(TRACE_DISK_HASH, (char *) &recorded, &size)
+                     || recorded != hash) {
+            trace->Diverge("the disk is not the one recorded");
+        }
+    }
 }
 
 /// Clean up disk simulation, by closing the UNIX file representing the disk.
@@ -160,6 +192,26 @@ Disk::WriteRequest(unsigned sectorNumber, const char *data)
     interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
 }
 
+void
+Disk::ReadSectorUntimed(unsigned sectorNumber, char *data)
+{
+    ASSERT(data != nullptr);
+    ASSERT(sectorNumber < NUM_SECTORS);
+
+    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+    SystemDep::Read(fileno, data, SECTOR_SIZE);
+}
+
+void
+Disk::WriteSectorUntimed(unsigned sectorNumber, const char *data)
+{
+    ASSERT(data != nullptr);
+    ASSERT(sectorNumber < NUM_SECTORS);
+
+    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+    SystemDep::WriteFile(fileno, data, SECTOR_SIZE);
+}
+
 /// Called when it is time to invoke the disk interrupt handler, to tell the
 /// Nachos kernel that the disk request is done.
 void
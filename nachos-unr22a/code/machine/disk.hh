@@ -74,6 +74,15 @@ public:
     void ReadRequest(unsigned sectorNumber, char *data);
     void WriteRequest(unsigned sectorNumber, const char *data);
 
+    /// Read/write a single disk sector straight on the UNIX file, at once.
+    ///
+    /// No request is made: they take no simulated time, count no I/O and
+    /// raise no interrupt.  They are for saving and restoring the machine,
+    /// not for the kernel.
+
+    void ReadSectorUntimed(unsigned sectorNumber, char *data);
+    void WriteSectorUntimed(unsigned sectorNumber, const char *data);
+
     /// Interrupt handler, invoked when disk request finishes.
     void HandleInterrupt();
 
@@ -44,6 +44,7 @@ Instruction::Decode()
                  (i == 0x110000) ? OP_BGEZAL :
                                    OP_UNIMP;
     }
+    handler = INSTR_HANDLERS[opCode];
 }
 
 int
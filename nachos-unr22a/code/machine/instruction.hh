@@ -10,6 +10,21 @@
 #include "encoding.hh"
 
 
+class Machine;
+class Instruction;
+
+/// Routine that simulates one kind of instruction in the threaded
+/// interpreter core (see `mips_sim.cc`).
+///
+/// It gets the machine, its register file and the decoded instruction, and
+/// it is responsible for retiring the instruction (delayed load and program
+/// counters) unless an exception is raised.
+typedef void (*InstrHandler)(Machine *machine, int *registers,
+                             const Instruction *instr);
+
+/// Handlers of the threaded core, indexed by `opCode`.
+extern const InstrHandler INSTR_HANDLERS[];
+
 /// The following class defines an instruction, represented in both:
 /// * undecoded binary form;
 /// * decoded to identify:
@@ -33,6 +48,8 @@ public:
     unsigned char rs, rt, rd;  ///< Three registers from instruction.
     int extra;  ///< Immediate or target or shamt field or offset.
                 ///< Immediates are sign-extended.
+    InstrHandler handler;  ///< Routine executing `opCode`, so the threaded
+                           ///< core does not have to dispatch on it.
 };
 
 
@@ -54,8 +54,10 @@ IsIntType(IntType t)
 /// * `param` is the argument to pass to the procedure.
 /// * `time` is when (in simulated time) the interrupt is to occur.
 /// * `kind` is the hardware device that generated the interrupt.
+/// * `target` is the processor that must handle it, or `ANY_CPU`.
 PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
-                                   unsigned long time, IntType kind)
+                                   unsigned long time, IntType kind,
+                                   int target)
 {
     ASSERT(func != nullptr);
     ASSERT(IsIntType(kind));
@@ -64,6 +66,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
     arg     = param;
     when    = time;
     type    = kind;
+    cpu     = target;
 }
 
 /// Initialize the simulation of hardware device interrupts.
@@ -76,6 +79,15 @@ Interrupt::Interrupt()
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
+    quietTicks    = 0;
+    pendingDevices = 0;
+    currentCpu    = 0;
+    for (unsigned i = 0; i < MAX_CPUS; i++) {
+        cpuTicks[i]  = 0;
+        cpuLevels[i] = INT_OFF;
+        cpuStatus[i] = SYSTEM_MODE;
+        posted[i]    = new List<PendingInterrupt *>;
+    }
 }
 
 /// De-allocate the data structures needed by the interrupt simulation.
@@ -85,6 +97,12 @@ Interrupt::~Interrupt()
         delete pending->Pop();
     }
     delete pending;
+    for (unsigned i = 0; i < MAX_CPUS; i++) {
+        while (!posted[i]->IsEmpty()) {
+            delete posted[i]->Pop();
+        }
+        delete posted[i];
+    }
 }
 
 /// Change interrupts to be enabled or disabled, without advancing the
@@ -143,7 +161,10 @@ Interrupt::Enable()
 /// Two things can cause `OneTick` to be called:
 /// * interrupts are re-enabled;
 /// * a user instruction is executed.
-void
+///
+/// Returns true if any interrupt handler was invoked (and thus possibly a
+/// context switch happened).
+bool
 Interrupt::OneTick()
 {
     MachineStatus old = status;
@@ -159,9 +180,16 @@ Interrupt::OneTick()
     DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
 
     // Check any pending interrupts are now ready to fire.
+    bool fired = false;
     ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
                                    // handlers run with interrupts disabled).
-    while (CheckIfDue(false)) {}   // Check for pending interrupts.
+    while (!posted[currentCpu]->IsEmpty()) {  // Interrupts that became due
+        Fire(posted[currentCpu]->Pop());      // while this processor was
+        fired = true;                         // not running.
+    }
+    while (CheckIfDue(false)) {    // Check for pending interrupts.
+        fired = true;
+    }
     ChangeLevel(INT_OFF, INT_ON);  // Re-enable interrupts.
     if (yieldOnReturn) {           // If the timer device handler asked for a
                                    // context switch, ok to do it now.
@@ -170,6 +198,55 @@ Interrupt::OneTick()
         currentThread->Yield();
         status = old;
     }
+    UpdateQuietTicks();
+    return fired;
+}
+
+/// Advance simulated time by one user instruction.
+///
+/// A user tick that cannot make any pending interrupt due only needs to
+/// be counted: `OneTick` would pop the first pending interrupt and put it
+/// back, and nothing else.  So while there are `quietTicks` left, this
+/// just updates the statistics; `Machine::Run` can thus run instructions
+/// back to back until an interrupt can actually fire, and the interleaving
+/// stays exactly the one given by `OneTick`.
+///
+/// Returns the same as `OneTick`.
+bool
+Interrupt::UserTick()
+{
+    if (quietTicks == 0 || yieldOnReturn || status != USER_MODE) {
+        return OneTick();
+    }
+    quietTicks--;
+    stats->totalTicks += USER_TICK;
+    stats->userTicks += USER_TICK;
+    return false;
+}
+
+unsigned long
+Interrupt::TicksUntilNextInterrupt() const
+{
+    if (pending->IsEmpty()) {
+        return ULONG_MAX;
+    }
+    unsigned long when = pending->Head()->when;
+    return when > stats->totalTicks ? when - stats->totalTicks : 0;
+}
+
+void
+Interrupt::UpdateQuietTicks()
+{
+    if (debug.IsEnabled('i') || !posted[currentCpu]->IsEmpty()) {
+        quietTicks = 0;  // Keep tracing every tick.
+        return;
+    }
+    unsigned long left = TicksUntilNextInterrupt();
+    if (left == ULONG_MAX) {
+        quietTicks = ULONG_MAX;
+    } else {
+        quietTicks = left > 0 ? (left - 1) / USER_TICK : 0;
+    }
 }
 
 /// Called from within an interrupt handler, to cause a context switch (for
@@ -204,6 +281,7 @@ Interrupt::Idle()
         yieldOnReturn = false;        // Since there is nothing in the ready
                                       // queue, the yield is automatic.
         status = SYSTEM_MODE;
+        UpdateQuietTicks();
         return;  // Return in case there is now a runnable thread.
     }
 
@@ -222,8 +300,20 @@ Interrupt::Idle()
 void
 Interrupt::Halt()
 {
+    // With several processors, the run lasted as long as the one that went
+    // furthest.
+    for (unsigned i = 0; i < stats->numCpus; i++) {
+        if (i != currentCpu && cpuTicks[i] > stats->totalTicks) {
+            stats->totalTicks = cpuTicks[i];
+        }
+    }
     printf("Machine halting!\n\n");
     stats->Print();
+#ifdef USER_PROGRAM
+    if (profiler != nullptr) {
+        profiler->Print();
+    }
+#endif
     Cleanup();  // Never returns.
 }
 
@@ -244,12 +334,17 @@ Interrupt::RestartTicks()
     unsigned          oldWhen = 0;
     while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
         unsigned newWhen = oldWhen - stats->totalTicks;
+        i->when = newWhen;
         pending->SortedInsert(i, newWhen);
         DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
               oldWhen, newWhen);
     }
 
     delete oldPending;
+    for (unsigned cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cpuTicks[cpu] = cpuTicks[cpu] > stats->totalTicks
+                        ? cpuTicks[cpu] - stats->totalTicks : 0;
+    }
     stats->totalTicks = 0;
     stats->tickResets += 1;
 }
@@ -268,9 +363,11 @@ Interrupt::RestartTicks()
 /// * `fromNow` is how far in the future (in simulated time) the interrupt is
 ///   to occur.
 /// * `type` is the hardware device that generated the interrupt.
+/// * `cpu` is the processor that must handle the interrupt; by default any
+///   of them, namely the one running when it becomes due.
 void
 Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
-                    unsigned long fromNow, IntType type)
+                    unsigned long fromNow, IntType type, int cpu)
 {
     ASSERT(handler != nullptr);
     ASSERT(fromNow > 0);
@@ -289,12 +386,16 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
 
     unsigned when = stats->totalTicks + fromNow;
     PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
-                                                     when, type);
+                                                     when, type, cpu);
+    if (type != TIMER_INT) {
+        pendingDevices++;
+    }
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
           INT_TYPE_NAMES[type], when);
 
     pending->SortedInsert(toOccur, when);
+    UpdateQuietTicks();
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -308,8 +409,7 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
 bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
-    MachineStatus old = status;
-    unsigned      when;
+    unsigned when;
 
     ASSERT(level == INT_OFF);  // Interrupts need to be disabled, to invoke
                                // an interrupt handler.
@@ -322,6 +422,19 @@ Interrupt::CheckIfDue(bool advanceClock)
         return false;
     }
 
+    // An interrupt for another processor is due: post it, so that it is
+    // handled as soon as that processor runs, and look at the next one.
+    // When idling, there is nothing running anywhere; just handle it.
+    while (!advanceClock && when <= stats->totalTicks
+             && toOccur->cpu != ANY_CPU
+             && (unsigned) toOccur->cpu != currentCpu) {
+        posted[toOccur->cpu]->Append(toOccur);
+        toOccur = pending->SortedPop((int *) &when);
+        if (toOccur == nullptr) {
+            return false;
+        }
+    }
+
     if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
         stats->idleTicks += (when - stats->totalTicks);
         stats->totalTicks = when;
@@ -332,11 +445,23 @@ Interrupt::CheckIfDue(bool advanceClock)
 
     // Check if there is nothing more to do, and if so, quit.
     if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
+          && pendingDevices == 0) {
         pending->SortedInsert(toOccur, when);
         return false;
     }
 
+    Fire(toOccur);
+    return true;
+}
+
+void
+Interrupt::Fire(PendingInterrupt *toOccur)
+{
+    MachineStatus old = status;
+
+    if (toOccur->type != TIMER_INT) {
+        pendingDevices--;
+    }
     DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
             INT_TYPE_NAMES[toOccur->type], toOccur->when);
 #ifdef USER_PROGRAM
@@ -351,7 +476,174 @@ Interrupt::CheckIfDue(bool advanceClock)
     status = old;  // Restore the machine status.
     inHandler = false;
     delete toOccur;
-    return true;
+}
+
+unsigned
+Interrupt::GetCpu() const
+{
+    return currentCpu;
+}
+
+unsigned long
+Interrupt::GetCpuTicks(unsigned cpu) const
+{
+    ASSERT(cpu < MAX_CPUS);
+    return cpu == currentCpu ? stats->totalTicks : cpuTicks[cpu];
+}
+
+/// Switch the simulation to another processor.
+///
+/// Every processor has its own local time, interrupt level and status.
+/// `stats->totalTicks`, `level` and `status` always hold those of the
+/// processor being simulated; the ones of the current processor are saved
+/// and the ones of `cpu` are loaded.
+///
+/// * `cpu` is the processor to switch to.
+/// * `wasIdle` tells that `cpu` had nothing to run until now: its time
+///   catches up with the current one, and the difference is idle time.
+void
+Interrupt::SelectCpu(unsigned cpu, bool wasIdle)
+{
+    ASSERT(cpu < stats->numCpus);
+    ASSERT(!inHandler);
+
+    unsigned long now = stats->totalTicks;
+    cpuTicks[currentCpu]  = now;
+    cpuLevels[currentCpu] = level;
+    cpuStatus[currentCpu] = status;
+
+    DEBUG('i', "Switching from processor %u to processor %u\n",
+          currentCpu, cpu);
+    currentCpu = cpu;
+    if (wasIdle && cpuTicks[cpu] < now) {
+        stats->idleTicks += now - cpuTicks[cpu];
+        cpuTicks[cpu] = now;
+    }
+    stats->totalTicks = cpuTicks[cpu];
+    level  = cpuLevels[cpu];
+    status = cpuStatus[cpu];
+    UpdateQuietTicks();
+}
+
+/// What a checkpoint keeps of a pending interrupt.
+///
+/// Handlers and their arguments are addresses in this run of Nachos, so
+/// they cannot be saved; the devices of the restored run schedule their own
+/// interrupts, and only get their times back.
+struct SavedInterrupt {
+    unsigned long when;
+    IntType type;
+    int cpu;
+};
+
+/// Write the clocks of the processors and the pending interrupts, including
+/// those already posted to another processor, to the host file `fd`.
+///
+/// The kernel only saves the machine when the device interrupts that are
+/// pending are the periodic ones (timers, console and network polls).
+void
+Interrupt::SaveCheckpoint(int fd)
+{
+    unsigned long clocks[MAX_CPUS];
+    for (unsigned cpu = 0; cpu < MAX_CPUS; cpu++) {
+        clocks[cpu] = GetCpuTicks(cpu);
+    }
+    SystemDep::WriteFile(fd, (char *) &currentCpu, sizeof currentCpu);
+    SystemDep::WriteFile(fd, (char *) clocks, sizeof clocks);
+
+    List<PendingInterrupt *> *all = new List<PendingInterrupt *>;
+    unsigned count = 0;
+    PendingInterrupt *i;
+    while ((i = pending->Pop()) != nullptr) {
+        all->Append(i);
+        count++;
+    }
+    for (unsigned cpu = 0; cpu < MAX_CPUS; cpu++) {
+        for (List<PendingInterrupt *> *p = posted[cpu]; !p->IsEmpty(); ) {
+            all->Append(p->Pop());
+            count++;
+        }
+    }
+
+    SystemDep::WriteFile(fd, (char *) &count, sizeof count);
+    while ((i = all->Pop()) != nullptr) {
+        SavedInterrupt saved = { i->when, i->type, i->cpu };
+        SystemDep::WriteFile(fd, (char *) &saved, sizeof saved);
+        pending->SortedInsert(i, i->when);  // Posted ones are simply due.
+    }
+    delete all;
+}
+
+/// Read back the clocks and interrupts saved by `SaveCheckpoint`.
+///
+/// Every interrupt pending now (scheduled by the devices of this run) takes
+/// the time of a saved interrupt of the same device and processor, in
+/// order; the ones that have no counterpart are moved forward as much as the
+/// clock.  The processor that was running when the checkpoint was taken
+/// becomes processor 0, the one running now.
+void
+Interrupt::RestoreCheckpoint(int fd)
+{
+    ASSERT(currentCpu == 0);
+
+    unsigned savedCpu;
+    unsigned long clocks[MAX_CPUS];
+    SystemDep::Read(fd, (char *) &savedCpu, sizeof savedCpu);
+    SystemDep::Read(fd, (char *) clocks, sizeof clocks);
+    ASSERT(savedCpu < MAX_CPUS);
+
+    unsigned count;
+    SystemDep::Read(fd, (char *) &count, sizeof count);
+    SavedInterrupt *saved = new SavedInterrupt[count];
+    bool *used = new bool[count];
+    for (unsigned j = 0; j < count; j++) {
+        SystemDep::Read(fd, (char *) &saved[j], sizeof saved[j]);
+        if (saved[j].cpu == (int) savedCpu) {
+            saved[j].cpu = 0;
+        } else if (saved[j].cpu == 0) {
+            saved[j].cpu = savedCpu;
+        }
+        used[j] = false;
+    }
+    unsigned long swapped = clocks[0];
+    clocks[0] = clocks[savedCpu];
+    clocks[savedCpu] = swapped;
+
+    unsigned long shift = clocks[0] - stats->totalTicks;
+    List<PendingInterrupt *> *oldPending = pending;
+    pending = new List<PendingInterrupt *>;
+    PendingInterrupt *i;
+    while ((i = oldPending->Pop()) != nullptr) {
+        unsigned j = 0;
+        while (j < count && (used[j] || saved[j].type != i->type
+                               || saved[j].cpu != i->cpu)) {
+            j++;
+        }
+        if (j < count) {
+            used[j] = true;
+            i->when = saved[j].when;
+        } else {
+            i->when += shift;
+        }
+        DEBUG('i', "Restored interrupt handler the %s at time = %lu\n",
+              INT_TYPE_NAMES[i->type], i->when);
+        pending->SortedInsert(i, i->when);
+    }
+    delete oldPending;
+    for (unsigned j = 0; j < count; j++) {
+        if (!used[j]) {
+            DEBUG('i', "Interrupt of the %s at time %lu not restored\n",
+                  INT_TYPE_NAMES[saved[j].type], saved[j].when);
+        }
+    }
+    delete [] saved;
+    delete [] used;
+
+    for (unsigned cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cpuTicks[cpu] = clocks[cpu];
+    }
+    stats->totalTicks = clocks[0];
+    UpdateQuietTicks();
 }
 
 IntStatus
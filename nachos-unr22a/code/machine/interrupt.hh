@@ -39,6 +39,12 @@
 #include "lib/list.hh"
 
 
+/// Maximum number of simulated processors.
+const unsigned MAX_CPUS = 8;
+
+/// Target of an interrupt that can be handled by any processor.
+const int ANY_CPU = -1;
+
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
 enum IntStatus {
     INT_OFF,
@@ -79,7 +85,7 @@ public:
 
     /// initialize an interrupt that will occur in the future.
     PendingInterrupt(VoidFunctionPtr func, void *param,
-                     unsigned long time, IntType kind);
+                     unsigned long time, IntType kind, int target);
 
     VoidFunctionPtr handler;  ///< The function (in the hardware device
                               ///< emulator) to call when the interrupt
@@ -87,6 +93,7 @@ public:
     void *arg;  ///< The argument to the function.
     unsigned long when;  ///< When the interrupt is supposed to fire.
     IntType type;  ///< For debugging.
+    int cpu;  ///< Processor that must handle the interrupt, or `ANY_CPU`.
 };
 
 /// The following class defines the data structures for the simulation
@@ -130,6 +137,23 @@ public:
     // Print interrupt state.
     void DumpState();
 
+    /// Processor whose time and interrupts are being simulated.
+    unsigned GetCpu() const;
+
+    /// Local time of processor `cpu`.
+    unsigned long GetCpuTicks(unsigned cpu) const;
+
+    /// Switch the simulation to processor `cpu`.
+    void SelectCpu(unsigned cpu, bool wasIdle);
+
+    /// Write the clocks of the processors and the pending interrupts to
+    /// the open host file `fd`, for a checkpoint of the machine.
+    void SaveCheckpoint(int fd);
+
+    /// Read back what `SaveCheckpoint` wrote, and move the clocks and the
+    /// interrupts the devices already scheduled to the saved times.
+    void RestoreCheckpoint(int fd);
+
 
     /// NOTE: the following are internal to the hardware simulation code.
     /// DO NOT call these directly.  I should make them “private”,
@@ -140,10 +164,22 @@ public:
     ///
     /// This is called by the hardware device simulators.
     void Schedule(VoidFunctionPtr handler, void *arg,
-                  unsigned long when, IntType type);
+                  unsigned long when, IntType type, int cpu = ANY_CPU);
 
     /// Advance simulated time.
-    void OneTick();
+    ///
+    /// Return true if an interrupt handler ran or the current thread
+    /// yielded, in which case the kernel may have changed machine state.
+    bool OneTick();
+
+    /// Advance simulated time by one user instruction.
+    ///
+    /// Same as `OneTick`, but cheap while no pending interrupt can be due.
+    bool UserTick();
+
+    /// Number of ticks from now until the next pending interrupt is due, or
+    /// `ULONG_MAX` if nothing is pending.
+    unsigned long TicksUntilNextInterrupt() const;
 
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
@@ -153,6 +189,30 @@ private:
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
     MachineStatus status;  ///< Idle, kernel mode, user mode.
+    unsigned long quietTicks;  ///< How many user instructions can still be
+                               ///< executed before any pending interrupt
+                               ///< can be due.
+
+    /// Recompute `quietTicks` after time advanced or an interrupt was
+    /// scheduled.
+    void UpdateQuietTicks();
+
+    /// Number of pending interrupts that do not come from a timer.
+    unsigned pendingDevices;
+
+    /// Processor being simulated.  The local time of the others is kept in
+    /// `cpuTicks`, and so are their interrupt level and status.
+    unsigned currentCpu;
+    unsigned long cpuTicks[MAX_CPUS];
+    IntStatus cpuLevels[MAX_CPUS];
+    MachineStatus cpuStatus[MAX_CPUS];
+
+    /// Interrupts that became due while another processor was being
+    /// simulated; they are handled as soon as their processor runs again.
+    List<PendingInterrupt *> *posted[MAX_CPUS];
+
+    /// Call the handler of an interrupt and dispose of it.
+    void Fire(PendingInterrupt *toOccur);
 
     /// These functions are internal to the interrupt simulation code.
 
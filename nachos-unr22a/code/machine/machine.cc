@@ -46,10 +46,21 @@ CheckEndian()
 /// * `st` -- pointer to an object that performs single stepping, for
 ///   dropping into it after each user instruction is executed; if null,
 ///   execute normally, without single stepping.
-Machine::Machine(SingleStepper *st)
+/// * `cpus` is the number of processors; each one has its own registers
+///   and TLB, and they all share main memory.
+Machine::Machine(SingleStepper *st, unsigned cpus)
 {
-    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
-        registers[i] = 0;
+    ASSERT(cpus > 0 && cpus <= MAX_CPUS);
+
+    numCpus = cpus;
+    cpuRegisters = new int [numCpus * NUM_TOTAL_REGS];
+    for (unsigned i = 0; i < numCpus * NUM_TOTAL_REGS; i++) {
+        cpuRegisters[i] = 0;
+    }
+    registers = cpuRegisters;
+    selectedCpu = 0;
+    for (unsigned i = 0; i < MAX_CPUS; i++) {
+        cpuProfiles[i] = nullptr;
     }
 
     for (unsigned i = 0; i < NUM_EXCEPTION_TYPES; i++) {
@@ -57,9 +68,17 @@ Machine::Machine(SingleStepper *st)
     }
 
     singleStepper = st;
+#ifdef DISPATCH_CROSS_CHECK
+    exceptionCount = 0;
+#endif
     CheckEndian();
 }
 
+Machine::~Machine()
+{
+    delete [] cpuRegisters;
+}
+
 const int *
 Machine::GetRegisters() const
 {
@@ -72,6 +91,33 @@ Machine::GetMMU()
     return &mmu;
 }
 
+unsigned
+Machine::GetNumCpus() const
+{
+    return numCpus;
+}
+
+void
+Machine::SelectCpu(unsigned cpu)
+{
+    ASSERT(cpu < numCpus);
+    registers = &cpuRegisters[cpu * NUM_TOTAL_REGS];
+    mmu.SelectCpu(cpu);
+    selectedCpu = cpu;
+}
+
+void
+Machine::SetProfile(Profile *p)
+{
+    cpuProfiles[selectedCpu] = p;
+}
+
+Profile *
+Machine::GetProfile() const
+{
+    return cpuProfiles[selectedCpu];
+}
+
 /// Fetch or write the contents of a user program register.
 int
 Machine::ReadRegister(unsigned num) const
@@ -171,6 +217,9 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     DEBUG('m', "Exception: %s\n", ExceptionTypeToString(et));
 
     //ASSERT(interrupt->GetStatus() == USER_MODE);
+#ifdef DISPATCH_CROSS_CHECK
+    exceptionCount++;
+#endif
     registers[BAD_VADDR_REG] = badVAddr;
     DelayedLoad(0, 0);  // Finish anything in progress.
 
@@ -23,6 +23,7 @@
 
 #include "exception_type.hh"
 #include "mmu.hh"
+#include "profile.hh"
 #include "single_stepper.hh"
 #include "lib/utility.hh"
 
@@ -51,6 +52,10 @@ class Instruction;
 
 typedef void (*ExceptionHandler)(ExceptionType);
 
+/// With several processors, number of user instructions a processor runs
+/// before the simulation moves on to another one.
+const unsigned CPU_QUANTUM = 16;
+
 /// The following class defines the simulated host workstation hardware, as
 /// seen by user programs -- the CPU registers, main memory, etc.
 ///
@@ -68,7 +73,9 @@ class Machine {
 public:
 
     /// Initialize the simulation of the hardware for running user programs.
-    Machine(SingleStepper *st);
+    Machine(SingleStepper *st, unsigned cpus = 1);
+
+    ~Machine();
 
     /// Routines callable by the Nachos kernel.
 
@@ -79,6 +86,23 @@ public:
 
     MMU *GetMMU();
 
+    /// Number of simulated processors.
+    unsigned GetNumCpus() const;
+
+    /// Make `cpu` the processor whose registers and MMU are in use.
+    ///
+    /// Only the scheduler should call this, between user instructions.
+    void SelectCpu(unsigned cpu);
+
+    /// Count the instructions run by the selected processor in `p`, or stop
+    /// counting if it is null.
+    ///
+    /// The kernel sets the profile of each program when switching to it.
+    void SetProfile(Profile *p);
+
+    /// Profile in use by the selected processor, if any.
+    Profile *GetProfile() const;
+
     /// Read the contents of a CPU register.
     int ReadRegister(unsigned num) const;
 
@@ -109,6 +133,20 @@ public:
     /// Run a certain instruction of a user program.
     void ExecInstruction(const Instruction *instr);
 
+    /// Run an instruction with the core selected at build time.
+    void Execute(const Instruction *instr);
+
+#ifdef BLOCK_CACHE
+    /// Run the decoded basic block at the current program counter.
+    void RunBlock();
+#endif
+
+#ifdef DISPATCH_CROSS_CHECK
+    /// Run an instruction with both interpreter cores and check that they
+    /// agree.
+    void CrossCheckInstruction(const Instruction *instr);
+#endif
+
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
 
@@ -130,12 +168,23 @@ private:
                                    ///< after each simulated instruction.
 
     /// Private data structures.
-    int registers[NUM_TOTAL_REGS];  ///< CPU registers, for executing user
-                                    ///< programs.
+    int *registers;  ///< CPU registers, for executing user programs; they
+                     ///< point into `cpuRegisters`.
+
+    unsigned numCpus;
+    int *cpuRegisters;  ///< Registers of every processor, `NUM_TOTAL_REGS`
+                        ///< each.
 
     MMU mmu; ///< Memory management unit.
 
+    unsigned selectedCpu;
+    Profile *cpuProfiles[MAX_CPUS];  ///< Profile in use by each processor.
+
     ExceptionHandler handlers[NUM_EXCEPTION_TYPES];  ///< Exception handlers.
+
+#ifdef DISPATCH_CROSS_CHECK
+    unsigned long exceptionCount;  ///< Number of traps into the kernel.
+#endif
 };
 
 
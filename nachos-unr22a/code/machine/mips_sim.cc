@@ -22,6 +22,15 @@
 ///
 /// Called by the kernel when the program starts up; never returns.
 ///
+/// Instructions are executed by the threaded core when `THREADED_DISPATCH`
+/// is defined, and by the reference `ExecInstruction` otherwise.  Defining
+/// `DISPATCH_CROSS_CHECK` runs both and compares them after every
+/// instruction.  With `BLOCK_CACHE`, whole basic blocks are run at a time
+/// unless single stepping, tracing or profiling.
+///
+/// With several processors, every `CPU_QUANTUM` instructions the scheduler
+/// is given the chance to switch to another processor.
+///
 /// This routine is re-entrant, in that it can be called multiple times
 /// concurrently -- one for each thread executing user code.
 void
@@ -35,17 +44,90 @@ Machine::Run()
     }
     interrupt->SetStatus(USER_MODE);
 
+    unsigned quantum = CPU_QUANTUM;
     for (;;) {
+        Profile *profile = cpuProfiles[selectedCpu];
+#ifdef BLOCK_CACHE
+        if (singleStepper == nullptr && numCpus == 1 && profile == nullptr
+              && !debug.IsEnabled('m') && !debug.IsEnabled('a')) {
+            RunBlock();
+            continue;
+        }
+#endif
         if (FetchInstruction(instr)) {
-            ExecInstruction(instr);
+            if (profile != nullptr) {
+                profile->CountInstruction(registers[PC_REG],
+                                          registers[PREV_PC_REG]);
+            }
+            Execute(instr);
+        }
+        interrupt->UserTick();
+        if (numCpus > 1 && --quantum == 0) {
+            quantum = CPU_QUANTUM;
+            scheduler->SwitchCpu();
         }
-        interrupt->OneTick();
         if (singleStepper != nullptr && !singleStepper->Step()) {
             singleStepper = nullptr;
         }
     }
 }
 
+/// Execute one fetched instruction with the interpreter core selected at
+/// build time.
+inline void
+Machine::Execute(const Instruction *instr)
+{
+#if defined(DISPATCH_CROSS_CHECK)
+    CrossCheckInstruction(instr);
+#elif defined(THREADED_DISPATCH)
+    (*instr->handler)(this, registers, instr);
+#else
+    ExecInstruction(instr);
+#endif
+}
+
+#ifdef BLOCK_CACHE
+/// Execute the basic block that starts at the current program counter.
+///
+/// The block comes already decoded from the MMU, so only its first
+/// instruction is translated; the rest are in the same page and are reached
+/// through the same translation entry.  Simulated time, the TLB use bits and
+/// the `TLBTotals` count advance exactly as when running one instruction at
+/// a time.
+///
+/// We fall back to the main loop as soon as the kernel may have changed the
+/// state the block relies on: when an instruction does not fall through
+/// (an exception was raised, or it is a jump target), when an interrupt
+/// handler runs (possibly switching threads and the TLB), or when the code
+/// page is written to or reloaded.
+void
+Machine::RunBlock()
+{
+    const Instruction *instr;
+    unsigned length;
+
+    stats->TLBTotals ++;
+    ExceptionType e = mmu.FetchInstruction(registers[PC_REG], &instr, &length);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
+        interrupt->UserTick();
+        return;
+    }
+
+    for (;;) {
+        int pc = registers[PC_REG];
+        Execute(instr);
+        bool interrupted = interrupt->UserTick();
+        if (--length == 0 || interrupted || registers[PC_REG] != pc + 4
+              || !mmu.IsStillDecoded(instr)) {
+            return;
+        }
+        stats->TLBTotals ++;  // Fetch of the next instruction.
+        instr++;
+    }
+}
+#endif
+
 /// Simulate effects of a delayed load.
 ///
 /// NOTE -- `RaiseException`/`CheckInterrupts` must also call `DelayedLoad`,
@@ -64,12 +146,14 @@ Machine::FetchInstruction(Instruction *instr)
 {
     ASSERT(instr != nullptr);
 
-    int raw;
-    if (!ReadMem(registers[PC_REG], 4, &raw)) {
+    stats->TLBTotals ++;
+    const Instruction *decoded;
+    ExceptionType e = mmu.FetchInstruction(registers[PC_REG], &decoded);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
         return false;  // Exception occurred.
     }
-    instr->value = raw;
-    instr->Decode();
+    *instr = *decoded;
 
     if (debug.IsEnabled('m')) {
         const struct OpString *str = &OP_STRINGS[instr->opCode];
@@ -653,3 +737,659 @@ Machine::ExecInstruction(const Instruction *instr)
     registers[PC_REG] = registers[NEXT_PC_REG];
     registers[NEXT_PC_REG] = pcAfter;
 }
+
+
+/// Threaded interpreter core.
+///
+/// Instead of switching on `opCode`, every decoded instruction carries a
+/// pointer to the routine that simulates it (`Instruction::handler`), so
+/// dispatch is a single indirect call.  Each routine only does the work its
+/// instruction needs: plain ALU operations retire with a fixed next PC and
+/// no delayed load, and only loads and branches compute anything else.
+///
+/// The routines must behave exactly as `ExecInstruction`, including its
+/// quirks, because both cores can be run in lockstep (see
+/// `DISPATCH_CROSS_CHECK`).
+
+/// Finish an instruction: apply the pending delayed load, record the new
+/// one and advance the program counters.
+static inline void
+Retire(int *r, int nextLoadReg, int nextLoadValue, int pcAfter)
+{
+    r[r[LOAD_REG]] = r[LOAD_VALUE_REG];
+    r[LOAD_REG] = nextLoadReg;
+    r[LOAD_VALUE_REG] = nextLoadValue;
+    r[0] = 0;
+    r[PREV_PC_REG] = r[PC_REG];
+    r[PC_REG] = r[NEXT_PC_REG];
+    r[NEXT_PC_REG] = pcAfter;
+}
+
+/// Retire an instruction that neither loads nor branches.
+static inline void
+RetireNext(int *r)
+{
+    Retire(r, 0, 0, r[NEXT_PC_REG] + 4);
+}
+
+/// Retire a conditional branch.
+static inline void
+RetireBranch(int *r, bool taken, int offset)
+{
+    Retire(r, 0, 0, r[NEXT_PC_REG] + (taken ? IndexToAddr(offset) : 4));
+}
+
+static void
+ExecAdd(Machine *m, int *r, const Instruction *in)
+{
+    int sum = r[in->rs] + r[in->rt];
+    if (!((r[in->rs] ^ r[in->rt]) & SIGN_BIT) && (r[in->rs] ^ sum) & SIGN_BIT) {
+        m->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return;
+    }
+    r[in->rd] = sum;
+    RetireNext(r);
+}
+
+static void
+ExecAddi(Machine *m, int *r, const Instruction *in)
+{
+    int sum = r[in->rs] + in->extra;
+    if (!((r[in->rs] ^ in->extra) & SIGN_BIT) && (in->extra ^ sum) & SIGN_BIT) {
+        m->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return;
+    }
+    r[in->rt] = sum;
+    RetireNext(r);
+}
+
+static void
+ExecAddiu(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rt] = r[in->rs] + in->extra;
+    RetireNext(r);
+}
+
+static void
+ExecAddu(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rs] + r[in->rt];
+    RetireNext(r);
+}
+
+static void
+ExecAnd(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rs] & r[in->rt];
+    RetireNext(r);
+}
+
+static void
+ExecAndi(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rt] = r[in->rs] & (in->extra & 0xFFFF);
+    RetireNext(r);
+}
+
+static void
+ExecBeq(Machine *m, int *r, const Instruction *in)
+{
+    RetireBranch(r, r[in->rs] == r[in->rt], in->extra);
+}
+
+static void
+ExecBgez(Machine *m, int *r, const Instruction *in)
+{
+    RetireBranch(r, !(r[in->rs] & SIGN_BIT), in->extra);
+}
+
+static void
+ExecBgezal(Machine *m, int *r, const Instruction *in)
+{
+    r[RET_ADDR_REG] = r[NEXT_PC_REG] + 4;
+    RetireBranch(r, !(r[in->rs] & SIGN_BIT), in->extra);
+}
+
+static void
+ExecBgtz(Machine *m, int *r, const Instruction *in)
+{
+    RetireBranch(r, r[in->rs] > 0, in->extra);
+}
+
+static void
+ExecBlez(Machine *m, int *r, const Instruction *in)
+{
+    RetireBranch(r, r[in->rs] <= 0, in->extra);
+}
+
+static void
+ExecBltz(Machine *m, int *r, const Instruction *in)
+{
+    RetireBranch(r, r[in->rs] & SIGN_BIT, in->extra);
+}
+
+static void
+ExecBltzal(Machine *m, int *r, const Instruction *in)
+{
+    r[RET_ADDR_REG] = r[NEXT_PC_REG] + 4;
+    RetireBranch(r, r[in->rs] & SIGN_BIT, in->extra);
+}
+
+static void
+ExecBne(Machine *m, int *r, const Instruction *in)
+{
+    RetireBranch(r, r[in->rs] != r[in->rt], in->extra);
+}
+
+static void
+ExecDiv(Machine *m, int *r, const Instruction *in)
+{
+    if (r[in->rt] == 0) {
+        r[LO_REG] = 0;
+        r[HI_REG] = 0;
+    } else {
+        r[LO_REG] = r[in->rs] / r[in->rt];
+        r[HI_REG] = r[in->rs] % r[in->rt];
+    }
+    RetireNext(r);
+}
+
+static void
+ExecDivu(Machine *m, int *r, const Instruction *in)
+{
+    unsigned rs = (unsigned) r[in->rs];
+    unsigned rt = (unsigned) r[in->rt];
+    if (rt == 0) {
+        r[LO_REG] = 0;
+        r[HI_REG] = 0;
+    } else {
+        r[LO_REG] = (int) (rs / rt);
+        r[HI_REG] = (int) (rs % rt);
+    }
+    RetireNext(r);
+}
+
+static void
+ExecJ(Machine *m, int *r, const Instruction *in)
+{
+    Retire(r, 0, 0,
+           ((r[NEXT_PC_REG] + 4) & 0xF0000000) | IndexToAddr(in->extra));
+}
+
+static void
+ExecJal(Machine *m, int *r, const Instruction *in)
+{
+    r[RET_ADDR_REG] = r[NEXT_PC_REG] + 4;
+    ExecJ(m, r, in);
+}
+
+static void
+ExecJr(Machine *m, int *r, const Instruction *in)
+{
+    Retire(r, 0, 0, r[in->rs]);
+}
+
+static void
+ExecJalr(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[NEXT_PC_REG] + 4;
+    Retire(r, 0, 0, r[in->rs]);
+}
+
+static void
+ExecLb(Machine *m, int *r, const Instruction *in)
+{
+    int value;
+    if (!m->ReadMem(r[in->rs] + in->extra, 1, &value)) {
+        return;
+    }
+    value = (value & 0x80 && in->opCode == OP_LB) ? value | 0xFFFFFF00
+                                                  : value & 0xFF;
+    Retire(r, in->rt, value, r[NEXT_PC_REG] + 4);
+}
+
+static void
+ExecLh(Machine *m, int *r, const Instruction *in)
+{
+    int addr = r[in->rs] + in->extra;
+    if (addr & 0x1) {
+        m->RaiseException(ADDRESS_ERROR_EXCEPTION, addr);
+        return;
+    }
+    int value;
+    if (!m->ReadMem(addr, 2, &value)) {
+        return;
+    }
+    value = (value & 0x8000 && in->opCode == OP_LH) ? value | 0xFFFF0000
+                                                    : value & 0xFFFF;
+    Retire(r, in->rt, value, r[NEXT_PC_REG] + 4);
+}
+
+static void
+ExecLui(Machine *m, int *r, const Instruction *in)
+{
+    DEBUG('m', "Executing: LUI r%d,%d\n", in->rt, in->extra);
+    r[in->rt] = in->extra << 16;
+    RetireNext(r);
+}
+
+static void
+ExecLw(Machine *m, int *r, const Instruction *in)
+{
+    int addr = r[in->rs] + in->extra;
+    if (addr & 0x3) {
+        m->RaiseException(ADDRESS_ERROR_EXCEPTION, addr);
+        return;
+    }
+    int value;
+    if (!m->ReadMem(addr, 4, &value)) {
+        return;
+    }
+    Retire(r, in->rt, value, r[NEXT_PC_REG] + 4);
+}
+
+/// Shared by `LWL` and `LWR`: the register value the partial load merges
+/// with, taking a load still in flight into account.
+static inline int
+MergeBase(const int *r, const Instruction *in)
+{
+    return r[LOAD_REG] == in->rt ? r[LOAD_VALUE_REG] : r[in->rt];
+}
+
+static void
+ExecLwl(Machine *m, int *r, const Instruction *in)
+{
+    int addr = r[in->rs] + in->extra;
+    ASSERT((addr & 0x3) == 0);  // See `ExecInstruction`.
+
+    int value;
+    if (!m->ReadMem(addr, 4, &value)) {
+        return;
+    }
+    int merged = MergeBase(r, in);
+    switch (addr & 0x3) {
+        case 0:
+            merged = value;
+            break;
+        case 1:
+            merged = (merged & 0xFF) | value << 8;
+            break;
+        case 2:
+            merged = (merged & 0xFFFF) | value << 16;
+            break;
+        case 3:
+            merged = (merged & 0xFFFFFF) | value << 24;
+            break;
+    }
+    Retire(r, in->rt, merged, r[NEXT_PC_REG] + 4);
+}
+
+static void
+ExecLwr(Machine *m, int *r, const Instruction *in)
+{
+    int addr = r[in->rs] + in->extra;
+    ASSERT((addr & 0x3) == 0);  // See `ExecInstruction`.
+
+    int value;
+    if (!m->ReadMem(addr, 4, &value)) {
+        return;
+    }
+    int merged = MergeBase(r, in);
+    switch (addr & 0x3) {
+        case 0:
+            merged = (merged & 0xFFFFFF00) | (value >> 24 & 0xFF);
+            break;
+        case 1:
+            merged = (merged & 0xFFFF0000) | (value >> 16 & 0xFFFF);
+            break;
+        case 2:
+            merged = (merged & 0xFF000000) | (value >> 8 & 0xFFFFFF);
+            break;
+        case 3:
+            merged = value;
+            break;
+    }
+    Retire(r, in->rt, merged, r[NEXT_PC_REG] + 4);
+}
+
+static void
+ExecMfhi(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[HI_REG];
+    RetireNext(r);
+}
+
+static void
+ExecMflo(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[LO_REG];
+    RetireNext(r);
+}
+
+static void
+ExecMthi(Machine *m, int *r, const Instruction *in)
+{
+    r[HI_REG] = r[in->rs];
+    RetireNext(r);
+}
+
+static void
+ExecMtlo(Machine *m, int *r, const Instruction *in)
+{
+    r[LO_REG] = r[in->rs];
+    RetireNext(r);
+}
+
+static void
+ExecMult(Machine *m, int *r, const Instruction *in)
+{
+    Mult(r[in->rs], r[in->rt], true, &r[HI_REG], &r[LO_REG]);
+    RetireNext(r);
+}
+
+static void
+ExecMultu(Machine *m, int *r, const Instruction *in)
+{
+    Mult(r[in->rs], r[in->rt], false, &r[HI_REG], &r[LO_REG]);
+    RetireNext(r);
+}
+
+static void
+ExecNor(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = ~(r[in->rs] | r[in->rt]);
+    RetireNext(r);
+}
+
+static void
+ExecOr(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rs] | r[in->rt];
+    RetireNext(r);
+}
+
+static void
+ExecOri(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rt] = r[in->rs] | (in->extra & 0xFFFF);
+    RetireNext(r);
+}
+
+static void
+ExecSb(Machine *m, int *r, const Instruction *in)
+{
+    if (!m->WriteMem((unsigned) (r[in->rs] + in->extra), 1, r[in->rt])) {
+        return;
+    }
+    RetireNext(r);
+}
+
+static void
+ExecSh(Machine *m, int *r, const Instruction *in)
+{
+    if (!m->WriteMem((unsigned) (r[in->rs] + in->extra), 2, r[in->rt])) {
+        return;
+    }
+    RetireNext(r);
+}
+
+static void
+ExecSll(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rt] << in->extra;
+    RetireNext(r);
+}
+
+static void
+ExecSllv(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rt] << (r[in->rs] & 0x1F);
+    RetireNext(r);
+}
+
+static void
+ExecSlt(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = (r[in->rs] < r[in->rt]) ? 1 : 0;
+    RetireNext(r);
+}
+
+static void
+ExecSlti(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rt] = (r[in->rs] < in->extra) ? 1 : 0;
+    RetireNext(r);
+}
+
+static void
+ExecSltiu(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rt] = ((unsigned) r[in->rs] < (unsigned) in->extra) ? 1 : 0;
+    RetireNext(r);
+}
+
+static void
+ExecSltu(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = ((unsigned) r[in->rs] < (unsigned) r[in->rt]) ? 1 : 0;
+    RetireNext(r);
+}
+
+static void
+ExecSra(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rt] >> in->extra;
+    RetireNext(r);
+}
+
+static void
+ExecSrav(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rt] >> (r[in->rs] & 0x1F);
+    RetireNext(r);
+}
+
+// NOTE: `ExecInstruction` shifts a signed temporary for `SRL` and `SRLV`,
+// so they behave as arithmetic shifts; the same is done here so that both
+// cores agree.
+
+static void
+ExecSrl(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rt] >> in->extra;
+    RetireNext(r);
+}
+
+static void
+ExecSrlv(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rt] >> (r[in->rs] & 0x1F);
+    RetireNext(r);
+}
+
+static void
+ExecSub(Machine *m, int *r, const Instruction *in)
+{
+    int diff = r[in->rs] - r[in->rt];
+    if ((r[in->rs] ^ r[in->rt]) & SIGN_BIT && (r[in->rs] ^ diff) & SIGN_BIT) {
+        m->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return;
+    }
+    r[in->rd] = diff;
+    RetireNext(r);
+}
+
+static void
+ExecSubu(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rs] - r[in->rt];
+    RetireNext(r);
+}
+
+static void
+ExecSw(Machine *m, int *r, const Instruction *in)
+{
+    if (!m->WriteMem((unsigned) (r[in->rs] + in->extra), 4, r[in->rt])) {
+        return;
+    }
+    RetireNext(r);
+}
+
+static void
+ExecSwl(Machine *m, int *r, const Instruction *in)
+{
+    int addr = r[in->rs] + in->extra;
+    ASSERT((addr & 0x3) == 0);  // See `ExecInstruction`.
+
+    int value;
+    if (!m->ReadMem(addr & ~0x3, 4, &value)) {
+        return;
+    }
+    switch (addr & 0x3) {
+        case 0:
+            value = r[in->rt];
+            break;
+        case 1:
+            value = (value & 0xFF000000) | (r[in->rt] >> 8 & 0xFFFFFF);
+            break;
+        case 2:
+            value = (value & 0xFFFF0000) | (r[in->rt] >> 16 & 0xFFFF);
+            break;
+        case 3:
+            value = (value & 0xFFFFFF00) | (r[in->rt] >> 24 & 0xFF);
+            break;
+    }
+    if (!m->WriteMem(addr & ~0x3, 4, value)) {
+        return;
+    }
+    RetireNext(r);
+}
+
+static void
+ExecSwr(Machine *m, int *r, const Instruction *in)
+{
+    int addr = r[in->rs] + in->extra;
+    ASSERT((addr & 0x3) == 0);  // See `ExecInstruction`.
+
+    int value;
+    if (!m->ReadMem(addr & ~0x3, 4, &value)) {
+        return;
+    }
+    switch (addr & 0x3) {
+        case 0:
+            value = (value & 0xFFFFFF) | r[in->rt] << 24;
+            break;
+        case 1:
+            value = (value & 0xFFFF) | r[in->rt] << 16;
+            break;
+        case 2:
+            value = (value & 0xFF) | r[in->rt] << 8;
+            break;
+        case 3:
+            value = r[in->rt];
+            break;
+    }
+    if (!m->WriteMem(addr & ~0x3, 4, value)) {
+        return;
+    }
+    RetireNext(r);
+}
+
+static void
+ExecSyscall(Machine *m, int *r, const Instruction *in)
+{
+    m->RaiseException(SYSCALL_EXCEPTION, 0);
+}
+
+static void
+ExecXor(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rd] = r[in->rs] ^ r[in->rt];
+    RetireNext(r);
+}
+
+static void
+ExecXori(Machine *m, int *r, const Instruction *in)
+{
+    r[in->rt] = r[in->rs] ^ (in->extra & 0xFFFF);
+    RetireNext(r);
+}
+
+static void
+ExecIllegal(Machine *m, int *r, const Instruction *in)
+{
+    m->RaiseException(ILLEGAL_INSTR_EXCEPTION, 0);
+}
+
+/// Opcodes that `Decode` never produces, and `RFE`, which is not simulated.
+static void
+ExecNotSimulated(Machine *m, int *r, const Instruction *in)
+{
+    ASSERT(false);
+}
+
+const InstrHandler INSTR_HANDLERS[MAX_OPCODE + 1] = {
+    ExecNotSimulated,  // 0
+    ExecAdd,      ExecAddi,     ExecAddiu,    ExecAddu,     ExecAnd,
+    ExecAndi,     ExecBeq,      ExecBgez,     ExecBgezal,   ExecBgtz,
+    ExecBlez,     ExecBltz,     ExecBltzal,   ExecBne,
+    ExecNotSimulated,  // 15
+    ExecDiv,      ExecDivu,     ExecJ,        ExecJal,      ExecJalr,
+    ExecJr,       ExecLb,       ExecLb,       ExecLh,       ExecLh,
+    ExecLui,      ExecLw,       ExecLwl,      ExecLwr,
+    ExecNotSimulated,  // 30
+    ExecMfhi,     ExecMflo,
+    ExecNotSimulated,  // 33
+    ExecMthi,     ExecMtlo,     ExecMult,     ExecMultu,    ExecNor,
+    ExecOr,       ExecOri,
+    ExecNotSimulated,  // OP_RFE
+    ExecSb,       ExecSh,       ExecSll,      ExecSllv,     ExecSlt,
+    ExecSlti,     ExecSltiu,    ExecSltu,     ExecSra,      ExecSrav,
+    ExecSrl,      ExecSrlv,     ExecSub,      ExecSubu,     ExecSw,
+    ExecSwl,      ExecSwr,      ExecXor,      ExecXori,     ExecSyscall,
+    ExecIllegal,  // OP_UNIMP
+    ExecIllegal   // OP_RES
+};
+
+#ifdef DISPATCH_CROSS_CHECK
+/// Execute `instr` with the reference core and then again, from the same
+/// starting state, with the threaded core, and stop if the resulting
+/// register files differ.
+///
+/// Instructions that trap into the kernel are only run by the reference
+/// core, since the handler (a system call, a page fault) must not run twice.
+/// Re-running a store is harmless: it writes the same value again.
+void
+Machine::CrossCheckInstruction(const Instruction *instr)
+{
+    int before[NUM_TOTAL_REGS];
+    int expected[NUM_TOTAL_REGS];
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        before[i] = registers[i];
+    }
+
+    unsigned long traps = exceptionCount;
+    ExecInstruction(instr);
+    if (exceptionCount != traps) {
+        return;
+    }
+
+    unsigned long memAccesses = stats->TLBTotals;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        expected[i] = registers[i];
+        registers[i] = before[i];
+    }
+    (*instr->handler)(this, registers, instr);
+    stats->TLBTotals = memAccesses;  // Count the accesses only once.
+
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        if (registers[i] != expected[i]) {
+            fprintf(stderr, "Threaded core mismatch at PC 0x%X"
+                    " (instruction 0x%08X, opcode %u): register %u is %d,"
+                    " expected %d.\n", before[PC_REG], instr->value,
+                    instr->opCode, i, registers[i], expected[i]);
+            ASSERT(false);
+        }
+    }
+}
+#endif
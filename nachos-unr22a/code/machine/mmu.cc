@@ -5,8 +5,8 @@
 ///
 /// Two types of translation are supported here.
 ///
-/// Linear page table -- the virtual page # is used as an index into the
-/// table, to find the physical page #.
+/// Hashed page table -- the virtual page # is looked up in the table, which
+/// the kernel keeps, to find the physical page #.
 ///
 /// Translation lookaside buffer -- associative lookup in the table to find
 /// an entry with the same virtual page #.  If found, this entry is used for
@@ -30,10 +30,36 @@
 
 #include "mmu.hh"
 #include "endianness.hh"
+#include "userprog/page_table.hh"
 
+#include <limits.h>
 #include <stdio.h>
 
 
+/// Sizes of the machine unless changed from the command line.
+static const unsigned DEFAULT_NUM_PHYS_PAGES = 128;
+static const unsigned DEFAULT_TLB_SIZE = 8;
+
+unsigned PAGE_SIZE = SECTOR_SIZE;
+unsigned NUM_PHYS_PAGES = DEFAULT_NUM_PHYS_PAGES;
+unsigned MEMORY_SIZE = DEFAULT_NUM_PHYS_PAGES * SECTOR_SIZE;
+unsigned TLB_SIZE = DEFAULT_TLB_SIZE;
+
+bool
+SetMachineSize(unsigned pageSize, unsigned numPhysPages, unsigned tlbSize)
+{
+    if (pageSize < 4 || (pageSize & (pageSize - 1)) != 0
+          || numPhysPages == 0 || tlbSize == 0
+          || numPhysPages > UINT_MAX / pageSize) {
+        return false;
+    }
+    PAGE_SIZE = pageSize;
+    NUM_PHYS_PAGES = numPhysPages;
+    MEMORY_SIZE = numPhysPages * pageSize;
+    TLB_SIZE = tlbSize;
+    return true;
+}
+
 MMU::MMU()
 {
     mainMemory = new char [MEMORY_SIZE];
@@ -41,23 +67,42 @@ MMU::MMU()
         mainMemory[i] = 0;
     }
 
+    decodedInstrs = new Instruction [MEMORY_SIZE / 4];
+    blockLengths  = new unsigned char [MEMORY_SIZE / 4];
+    decodedFrames = new bool [NUM_PHYS_PAGES];
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        decodedFrames[i] = false;
+    }
+
+    InvalidateTranslationCache();
+
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLB_SIZE];
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
-        tlb[i].valid = false;
+    tlbs = new TranslationEntry[MAX_CPUS * TLB_SIZE];
+    for (unsigned i = 0; i < MAX_CPUS * TLB_SIZE; i++) {
+        tlbs[i].valid = false;
     }
+    tlb = tlbs;
     pageTable = nullptr;
-#else  // Use linear page table.
+#else  // Use the page table.
+    tlbs = nullptr;
     tlb = nullptr;
     pageTable = nullptr;
 #endif
+    currentCpu = 0;
+    for (unsigned i = 0; i < MAX_CPUS; i++) {
+        cpuPageTables[i] = nullptr;
+        cpuAsids[i] = 0;
+    }
 }
 
 MMU::~MMU()
 {
     delete [] mainMemory;
-    if (tlb != nullptr) {
-        delete [] tlb;
+    delete [] decodedInstrs;
+    delete [] blockLengths;
+    delete [] decodedFrames;
+    if (tlbs != nullptr) {
+        delete [] tlbs;
     }
 }
 
@@ -68,8 +113,8 @@ MMU::PrintTLB() const
     printf("TLB content (%u entries):\n", TLB_SIZE);
     for (unsigned i = 0; i < TLB_SIZE; i++) {
         const TranslationEntry *e = &tlb[i];
-        printf("(%u) valid: %d, virt: %d, frame: %d, flags: %s%s%s\n",
-               i, e->valid, e->virtualPage, e->physicalPage,
+        printf("(%u) valid: %d, asid: %u, virt: %d, frame: %d, flags: %s%s%s\n",
+               i, e->valid, e->asid, e->virtualPage, e->physicalPage,
                (e->readOnly) ? "readonly " : "",
                (e->use)      ? "use " : "",
                (e->dirty)    ? "dirty" : "");
@@ -95,8 +140,8 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 
     DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
 
-    unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, false);
+    char *host;
+    ExceptionType e = TranslateToHost(readCache, addr, size, false, &host);
     if (e != NO_EXCEPTION) {
         return e; 
     }
@@ -104,17 +149,17 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
     int data;
     switch (size) {
         case 1:
-            data = mainMemory[physicalAddress];
+            data = *host;
             *value = data;
             break;
 
         case 2:
-            data = *(unsigned short *) &mainMemory[physicalAddress];
+            data = *(unsigned short *) host;
             *value = ShortToHost(data);
             break;
 
         case 4:
-            data = *(unsigned *) &mainMemory[physicalAddress];
+            data = *(unsigned *) host;
             *value = WordToHost(data);
             break;
 
@@ -140,65 +185,226 @@ MMU::WriteMem(unsigned addr, unsigned size, int value)
 {
     DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, size, value);
 
-    unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, true);
+    char *host;
+    ExceptionType e = TranslateToHost(writeCache, addr, size, true, &host);
     if (e != NO_EXCEPTION) {
         return e;
     }
 
     switch (size) {
         case 1:
-            mainMemory[physicalAddress]
-              = (unsigned char) (value & 0xFF);
+            *host = (unsigned char) (value & 0xFF);
             break;
 
         case 2:
-            *(unsigned short *) &mainMemory[physicalAddress]
+            *(unsigned short *) host
               = ShortToMachine((unsigned short) (value & 0xFFFF));
             break;
 
         case 4:
-            *(unsigned *) &mainMemory[physicalAddress]
-              = WordToMachine((unsigned) value);
+            *(unsigned *) host = WordToMachine((unsigned) value);
             break;
 
         default:
             ASSERT(false);
     }
 
+    // The frame may hold code; its decoded form is now stale.
+    decodedFrames[(host - mainMemory) / PAGE_SIZE] = false;
+
+    return NO_EXCEPTION;
+}
+
+/// Fetch the instruction at virtual address `addr`.
+///
+/// The translation is done exactly as for a 4 byte `ReadMem` (so use bits,
+/// TLB faults and alignment errors are unchanged), but the word is not
+/// decoded again if its frame was already decoded.
+///
+/// * `addr` is the virtual address of the instruction.
+/// * `instr` is where to store a pointer to the decoded instruction; it
+///   stays valid until the next call that may invalidate the frame.
+ExceptionType
+MMU::FetchInstruction(unsigned addr, const Instruction **instr,
+                      unsigned *blockLength)
+{
+    ASSERT(instr != nullptr);
+
+    DEBUG('a', "Fetching VA 0x%X\n", addr);
+
+    unsigned vpn = addr / PAGE_SIZE;
+    char *host;
+    if (codePage.vpn == vpn && (addr & 0x3) == 0) {
+        codePage.entry->use = true;
+        host = codePage.frame + addr % PAGE_SIZE;
+    } else {
+        ExceptionType e = TranslateToHost(fetchCache, addr, 4, false, &host);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+        codePage = fetchCache[vpn % HOST_CACHE_SIZE];
+    }
+
+    unsigned physicalAddress = host - mainMemory;
+    unsigned frame = physicalAddress / PAGE_SIZE;
+    if (!decodedFrames[frame]) {
+        DecodeFrame(frame);
+    }
+    *instr = &decodedInstrs[physicalAddress / 4];
+    if (blockLength != nullptr) {
+        *blockLength = blockLengths[physicalAddress / 4];
+    }
     return NO_EXCEPTION;
 }
 
+bool
+MMU::IsStillDecoded(const Instruction *instr) const
+{
+    ASSERT(instr >= decodedInstrs && instr < decodedInstrs + MEMORY_SIZE / 4);
+    return decodedFrames[(instr - decodedInstrs) * 4 / PAGE_SIZE];
+}
+
+void
+MMU::InvalidateDecodedFrame(unsigned frame)
+{
+    ASSERT(frame < NUM_PHYS_PAGES);
+    decodedFrames[frame] = false;
+}
+
+void
+MMU::InvalidateTranslationCache()
+{
+    for (unsigned i = 0; i < HOST_CACHE_SIZE; i++) {
+        readCache[i].vpn  = NO_VPN;
+        writeCache[i].vpn = NO_VPN;
+        fetchCache[i].vpn = NO_VPN;
+    }
+    codePage.vpn = NO_VPN;
+}
+
+void
+MMU::SelectCpu(unsigned cpu)
+{
+    ASSERT(cpu < MAX_CPUS);
+
+    cpuPageTables[currentCpu] = pageTable;
+    currentCpu = cpu;
+    pageTable  = cpuPageTables[cpu];
+    if (tlbs != nullptr) {
+        tlb = &tlbs[cpu * TLB_SIZE];
+    }
+    InvalidateTranslationCache();
+}
+
+TranslationEntry *
+MMU::GetTlb(unsigned cpu)
+{
+    ASSERT(cpu < MAX_CPUS);
+    return tlbs != nullptr ? &tlbs[cpu * TLB_SIZE] : nullptr;
+}
+
+void
+MMU::SetAsid(unsigned cpu, unsigned asid)
+{
+    ASSERT(cpu < MAX_CPUS);
+    ASSERT(asid < NUM_ASIDS);
+
+    cpuAsids[cpu] = asid;
+    if (cpu == currentCpu) {
+        InvalidateTranslationCache();
+    }
+}
+
+unsigned
+MMU::GetAsid() const
+{
+    return cpuAsids[currentCpu];
+}
+
+/// Branches and jumps end a basic block (after their delay slot).
+static inline bool
+IsControlTransfer(unsigned char op)
+{
+    switch (op) {
+        case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+        case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+        case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Instructions that always enter the kernel end a basic block right away.
+static inline bool
+AlwaysTraps(unsigned char op)
+{
+    return op == OP_SYSCALL || op == OP_UNIMP || op == OP_RES
+           || op == OP_RFE;
+}
+
+void
+MMU::DecodeFrame(unsigned frame)
+{
+    ASSERT(frame < NUM_PHYS_PAGES);
+
+    DEBUG('a', "\tDecoding physical page %u\n", frame);
+    const unsigned first = frame * PAGE_SIZE / 4;
+    const unsigned last  = first + PAGE_SIZE / 4 - 1;
+    for (unsigned i = first; i <= last; i++) {
+        Instruction *in = &decodedInstrs[i];
+        in->value = WordToHost(*(unsigned *) &mainMemory[i * 4]);
+        in->Decode();
+    }
+
+    // Delimit basic blocks, walking backwards so that each word can extend
+    // the block of the word after it.
+    for (unsigned i = last + 1; i-- > first; ) {
+        unsigned char op = decodedInstrs[i].opCode;
+        if (i == last || AlwaysTraps(op)) {
+            blockLengths[i] = 1;
+        } else if (IsControlTransfer(op)) {
+            blockLengths[i] = 2;  // Include the delay slot.
+        } else if (blockLengths[i + 1] < UCHAR_MAX) {
+            blockLengths[i] = blockLengths[i + 1] + 1;
+        } else {
+            blockLengths[i] = UCHAR_MAX;  // Longer blocks are run in parts.
+        }
+    }
+    decodedFrames[frame] = true;
+}
+
 ExceptionType
 MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 {
     ASSERT(entry != nullptr);
 
     if (tlb == nullptr) {
-        // Use a page table; `vpn` is an index in the table.
+        // Use a page table; `vpn` is looked up in the table.
 
-        if (vpn >= pageTableSize) {
+        if (vpn >= pageTable->GetNumPages()) {
             DEBUG_CONT('a', "virtual page # %u too large for"
-                            " page table size %u!\n",
-                       vpn, pageTableSize);
+                            " address space of %u pages!\n",
+                       vpn, pageTable->GetNumPages());
             return ADDRESS_ERROR_EXCEPTION;
-        } else if (!pageTable[vpn].valid) {
-            DEBUG_CONT('a', "virtual page # %u too large for"
-                            " page table size %u!\n",
-                       vpn, pageTableSize);
+        }
+        PageTableEntry *e = pageTable->Find(vpn);
+        if (e == nullptr || !e->translation.valid) {
+            DEBUG_CONT('a', "no valid entry for virtual page # %u!\n", vpn);
             return PAGE_FAULT_EXCEPTION;
         }
 
-        *entry = &pageTable[vpn];
+        *entry = &e->translation;
         return NO_EXCEPTION;
 
     } else {
         // Use the TLB.
 
+        unsigned asid = cpuAsids[currentCpu];
         unsigned i;
         for (i = 0; i < TLB_SIZE; i++) {
             TranslationEntry *e = &tlb[i];
-            if (e->valid && e->virtualPage == vpn) {
+            if (e->valid && e->virtualPage == vpn && e->asid == asid) {
                 *entry = e;  // FOUND!
                 return NO_EXCEPTION;
             }
@@ -212,6 +418,47 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
     }
 }
 
+/// Translate a virtual address into a host address inside `mainMemory`.
+///
+/// A hit in `cache` behaves exactly as `Translate` would: the page was
+/// translated successfully before and nothing changed since (otherwise the
+/// kernel would have called `InvalidateTranslationCache`), so only the
+/// alignment has to be checked and the use and dirty bits set.  On a miss,
+/// the translation is done by `Translate` and remembered, except when
+/// tracing with `-d a`, so that every access still gets traced.
+///
+/// * `cache` is the host translation cache for this kind of access.
+/// * `host` is where to store the translated address.
+ExceptionType
+MMU::TranslateToHost(HostPage *cache, unsigned virtAddr, unsigned size,
+                     bool writing, char **host)
+{
+    unsigned vpn = virtAddr / PAGE_SIZE;
+    HostPage *slot = &cache[vpn % HOST_CACHE_SIZE];
+    if (slot->vpn == vpn && (virtAddr & (size - 1)) == 0) {
+        slot->entry->use = true;
+        if (writing) {
+            slot->entry->dirty = true;
+        }
+        *host = slot->frame + virtAddr % PAGE_SIZE;
+        return NO_EXCEPTION;
+    }
+
+    unsigned physAddr;
+    TranslationEntry *entry;
+    ExceptionType e = Translate(virtAddr, &physAddr, size, writing, &entry);
+    if (e != NO_EXCEPTION) {
+        return e;
+    }
+    *host = &mainMemory[physAddr];
+    if (!debug.IsEnabled('a')) {
+        slot->vpn   = vpn;
+        slot->frame = *host - virtAddr % PAGE_SIZE;
+        slot->entry = entry;
+    }
+    return NO_EXCEPTION;
+}
+
 /// Translate a virtual address into a physical address, using
 /// either a page table or a TLB.
 ///
@@ -224,9 +471,10 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 /// * `physAddr" is the place to store the physical address.
 /// * `size" is the amount of memory being read or written.
 /// * `writing` -- if true, check the “read-only” bit in the TLB.
+/// * `usedEntry` -- if not null, where to store the translation entry used.
 ExceptionType
 MMU::Translate(unsigned virtAddr, unsigned *physAddr,
-               unsigned size, bool writing)
+               unsigned size, bool writing, TranslationEntry **usedEntry)
 {
     ASSERT(physAddr != nullptr);
     // We must have either a TLB or a page table, but not both!
@@ -273,6 +521,9 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
         entry->dirty = true;
     }
 
+    if (usedEntry != nullptr) {
+        *usedEntry = entry;
+    }
     *physAddr = pageFrame * PAGE_SIZE + offset;
     ASSERT(*physAddr >= 0 && *physAddr + size <= MEMORY_SIZE);
     DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
@@ -11,21 +11,40 @@
 
 #include "exception_type.hh"
 #include "disk.hh"
+#include "instruction.hh"
+#include "interrupt.hh"
 #include "translation_entry.hh"
 
 
+class PageTable;
+
 /// Definitions related to the size, and format of user memory.
+///
+/// They are parameters of the simulated machine, rather than constants:
+/// they can be changed from the command line with `SetMachineSize`, but
+/// only before the machine is created.  They never change afterwards.
 
-const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
-                                         ///< disk sector size, for
-                                         ///< simplicity.
-const unsigned NUM_PHYS_PAGES = 128;
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
+extern unsigned PAGE_SIZE;  ///< By default, equal to the disk sector size,
+                            ///< for simplicity.
+extern unsigned NUM_PHYS_PAGES;
+extern unsigned MEMORY_SIZE;  ///< Always `NUM_PHYS_PAGES * PAGE_SIZE`.
 
 /// Number of entries in the TLB, if one is present.
 ///
 /// If there is a TLB, it will be small compared to page tables.
-const unsigned TLB_SIZE = 8;
+extern unsigned TLB_SIZE;
+
+/// Change the size of the pages, of physical memory (in pages) and of the
+/// TLB.
+///
+/// Returns false, changing nothing, if the page size is not a power of two
+/// of at least 4 bytes, if any size is zero, or if memory would not fit in
+/// the address space.
+bool SetMachineSize(unsigned pageSize, unsigned numPhysPages,
+                    unsigned tlbSize);
+
+/// Number of address space identifiers that TLB entries can be tagged with.
+const unsigned NUM_ASIDS = 64;
 
 
 /// This class simulates an MMU (memory management unit) that can use either
@@ -45,8 +64,59 @@ public:
 
     ExceptionType WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Translate `addr` as an instruction fetch and point `instr` to its
+    /// decoded form.
+    ///
+    /// Instructions are decoded a whole frame at a time, the first time
+    /// code is fetched from that frame, and the decoded records are reused
+    /// until the frame is invalidated.
+    ///
+    /// If `blockLength` is not null, it receives the number of instructions
+    /// of the basic block starting at `addr`: the instructions that follow
+    /// sequentially in the same page, up to and including the delay slot of
+    /// the first branch or jump, or up to the first instruction that always
+    /// traps.  They are laid out contiguously after `*instr`.
+    ExceptionType FetchInstruction(unsigned addr, const Instruction **instr,
+                                   unsigned *blockLength = nullptr);
+
+    /// Tell whether the frame holding a decoded instruction returned by
+    /// `FetchInstruction` is still decoded, that is, whether the frame has
+    /// not been written or reloaded since.
+    bool IsStillDecoded(const Instruction *instr) const;
+
+    /// Forget the decoded instructions of physical page `frame`.
+    ///
+    /// Stores through `WriteMem` do this automatically; kernel code that
+    /// fills `mainMemory` directly (page-in, frame reuse) must call it.
+    void InvalidateDecodedFrame(unsigned frame);
+
+    /// Forget every cached host translation.
+    ///
+    /// The MMU remembers, per virtual page, where in `mainMemory` the last
+    /// successful translation led, so that later accesses to the same page
+    /// skip the TLB or page table lookup.  Kernel code must call this after
+    /// changing the TLB, the page table or the page table pointer.
+    void InvalidateTranslationCache();
+
     void PrintTLB() const;
 
+    /// Switch `tlb` and `pageTable` to those of processor `cpu`.
+    ///
+    /// Every processor has its own TLB and page table register; they all
+    /// share `mainMemory`.
+    void SelectCpu(unsigned cpu);
+
+    /// TLB of processor `cpu`, for invalidating entries of other
+    /// processors (TLB shootdown).
+    TranslationEntry *GetTlb(unsigned cpu);
+
+    /// Set the identifier of the address space that processor `cpu` runs;
+    /// its TLB only matches entries tagged with it.
+    void SetAsid(unsigned cpu, unsigned asid);
+
+    /// Identifier of the address space the selected processor runs.
+    unsigned GetAsid() const;
+
     /// Data structures -- all of these are accessible to Nachos kernel code.
     /// “Public” for convenience.
     ///
@@ -60,11 +130,13 @@ public:
     /// NOTE: the hardware translation of virtual addresses in the user
     /// program to physical addresses (relative to the beginning of
     /// `mainMemory`) can be controlled by one of:
-    /// * a traditional linear page table;
+    /// * a hashed page table, with entries only for some of the pages of
+    ///   the address space (see `userprog/page_table.hh`);
     /// * a software-loaded translation lookaside buffer (tlb) -- a cache of
     ///   mappings of virtual page #'s to physical page #'s.
     ///
-    /// If `tlb` is null, the linear page table is used.
+    /// If `tlb` is null, the page table is used: a page with no entry, or
+    /// an invalid one, faults.
     /// If `tlb` is non-null, the Nachos kernel is responsible for managing
     /// the contents of the TLB.  But the kernel can use any data structure
     /// it wants (eg, segmented paging) for handling TLB cache misses.
@@ -79,11 +151,63 @@ public:
     TranslationEntry *tlb;  ///< This pointer should be considered
                             ///< “read-only” to Nachos kernel code.
 
-    TranslationEntry *pageTable;
-    unsigned pageTableSize;
+    PageTable *pageTable;
 
 private:
 
+    /// TLBs of all processors, `TLB_SIZE` entries each.
+    TranslationEntry *tlbs;
+
+    /// Processor whose TLB and page table are in use.  The page tables of
+    /// the others are saved here.
+    unsigned currentCpu;
+    PageTable *cpuPageTables[MAX_CPUS];
+
+    /// Address space identifier register of every processor.
+    unsigned cpuAsids[MAX_CPUS];
+
+    /// Decoded instruction cache, indexed by physical word.  Only the
+    /// frames flagged in `decodedFrames` hold valid records.
+    Instruction *decodedInstrs;
+    bool *decodedFrames;
+
+    /// Length of the basic block starting at each word of `decodedInstrs`.
+    unsigned char *blockLengths;
+
+    /// Decode every instruction word of physical page `frame`.
+    void DecodeFrame(unsigned frame);
+
+    /// A virtual page known to translate without faults, and the host
+    /// address of its frame.
+    struct HostPage {
+        unsigned vpn;  ///< `NO_VPN` if the slot is empty.
+        char *frame;
+        TranslationEntry *entry;  ///< Entry whose use and dirty bits must
+                                  ///< still be set on every access.
+    };
+
+    static const unsigned NO_VPN = (unsigned) -1;
+
+    /// Number of slots of each host translation cache; they are
+    /// direct-mapped by virtual page number.
+    static const unsigned HOST_CACHE_SIZE = 32;
+
+    /// Host translation caches for loads, stores and instruction fetches.
+    /// They are kept apart so that a page that was only read never skips
+    /// the read-only check, and so that code and data do not evict each
+    /// other.
+    HostPage readCache[HOST_CACHE_SIZE];
+    HostPage writeCache[HOST_CACHE_SIZE];
+    HostPage fetchCache[HOST_CACHE_SIZE];
+
+    /// The page instructions are currently being fetched from.
+    HostPage codePage;
+
+    /// Translate `virtAddr` to a host address, first through `cache` and
+    /// otherwise through `Translate`, caching the result.
+    ExceptionType TranslateToHost(HostPage *cache, unsigned virtAddr,
+                                  unsigned size, bool writing, char **host);
+
     /// Retrieve a page entry either from a page table or the TLB.
     ExceptionType RetrievePageEntry(unsigned vpn,
                                     TranslationEntry **entry) const;
@@ -94,7 +218,8 @@ private:
     /// and return an exception code if the translation could not be
     /// completed.
     ExceptionType Translate(unsigned virtAddr, unsigned *physAddr,
-                            unsigned size, bool writing);
+                            unsigned size, bool writing,
+                            TranslationEntry **usedEntry = nullptr);
 };
 
 
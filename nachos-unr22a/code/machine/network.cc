@@ -86,13 +86,28 @@ Network::CheckPktAvail()
     if (inHdr.length != 0) {  // Do nothing if packet is already buffered.
         return;
     }
-    if (!SystemDep::PollSocket(sock)) {  // Do nothing if no packet to read.
-        return;
-    }
-
-    // Otherwise, read packet in.
     char *buffer = new char [MAX_WIRE_SIZE];
-    SystemDep::ReadFromSocket(sock, buffer, MAX_WIRE_SIZE);
+    if (trace != nullptr && trace->IsReplaying()) {
+        // The packet, if any, comes from the trace instead.
+        unsigned size = MAX_WIRE_SIZE;
+        if (!trace->Replay(TRACE_PACKET, buffer, &size)) {
+            delete [] buffer;
+            return;
+        }
+    } else {
+        if (!SystemDep::PollSocket(sock)) {  // Do nothing if no packet to
+            delete [] buffer;                // read.
+            return;
+        }
+
+        // Otherwise, read packet in.
+        SystemDep::ReadFromSocket(sock, buffer, MAX_WIRE_SIZE);
+        if (trace != nullptr) {
+            const PacketHeader *hdr = (const PacketHeader *) buffer;
+            trace->Record(TRACE_PACKET, buffer,
+                          sizeof (PacketHeader) + hdr->length);
+        }
+    }
 
     // Divide packet into header and data.
     inHdr = *(PacketHeader *) buffer;
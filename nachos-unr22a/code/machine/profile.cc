@@ -0,0 +1,207 @@
+/// Routines to profile user programs.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "profile.hh"
+#include "lib/utility.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/// Not word aligned, so that it never matches an instruction.
+static const unsigned NO_PC = 1;
+
+Profile::Profile(const char *programName)
+{
+    ASSERT(programName != nullptr);
+
+    name = new char [strlen(programName) + 1];
+    strcpy(name, programName);
+    counts = nullptr;
+    numCounts = 0;
+    symbols = nullptr;
+    numSymbols = 0;
+    lastPc = NO_PC;
+}
+
+Profile::~Profile()
+{
+    for (unsigned i = 0; i < numSymbols; i++) {
+        delete [] symbols[i].name;
+    }
+    delete [] symbols;
+    delete [] counts;
+    delete [] name;
+}
+
+const char *
+Profile::GetName() const
+{
+    return name;
+}
+
+void
+Profile::AddSymbol(unsigned address, const char *symbolName)
+{
+    ASSERT(symbolName != nullptr);
+
+    Symbol *grown = new Symbol [numSymbols + 1];
+    unsigned i = 0;
+    for (; i < numSymbols && symbols[i].address <= address; i++) {
+        grown[i] = symbols[i];
+    }
+    grown[i].address = address;
+    grown[i].name = new char [strlen(symbolName) + 1];
+    strcpy(grown[i].name, symbolName);
+    for (; i < numSymbols; i++) {
+        grown[i + 1] = symbols[i];
+    }
+    delete [] symbols;
+    symbols = grown;
+    numSymbols++;
+}
+
+Profile::PcCounts *
+Profile::At(unsigned pc)
+{
+    unsigned index = pc / 4;
+    if (index >= numCounts) {
+        unsigned size = numCounts == 0 ? 256 : numCounts;
+        while (size <= index) {
+            size *= 2;
+        }
+        PcCounts *grown = new PcCounts [size];
+        memset(grown, 0, size * sizeof *grown);
+        if (counts != nullptr) {
+            memcpy(grown, counts, numCounts * sizeof *counts);
+        }
+        delete [] counts;
+        counts = grown;
+        numCounts = size;
+    }
+    return &counts[index];
+}
+
+void
+Profile::CountInstruction(unsigned pc, unsigned prevPc)
+{
+    PcCounts *c = At(pc);
+    c->instructions++;
+    // Running the same instruction again is a retry after an exception.
+    if (pc != prevPc + 4 && pc != lastPc) {
+        c->blocks++;
+    }
+    lastPc = pc;
+}
+
+void
+Profile::CountTlbMiss(unsigned pc)
+{
+    At(pc)->tlbMisses++;
+}
+
+void
+Profile::CountPageFault(unsigned pc)
+{
+    At(pc)->pageFaults++;
+}
+
+int
+Profile::FindSymbol(unsigned pc) const
+{
+    int found = -1;
+    for (unsigned i = 0; i < numSymbols && symbols[i].address <= pc; i++) {
+        found = i;
+    }
+    return found;
+}
+
+void
+Profile::PrintLocation(unsigned pc) const
+{
+    int s = FindSymbol(pc);
+    if (s < 0) {
+        printf("0x%08X", pc);
+    } else {
+        printf("0x%08X %s+0x%X", pc, symbols[s].name,
+               pc - symbols[s].address);
+    }
+}
+
+unsigned
+Profile::Hottest(unsigned long PcCounts::*field, unsigned *top) const
+{
+    unsigned found = 0;
+    for (unsigned i = 0; i < numCounts; i++) {
+        unsigned long v = counts[i].*field;
+        if (v == 0 || (found == PROFILE_TOP
+                         && counts[top[found - 1]].*field >= v)) {
+            continue;
+        }
+        unsigned j = found < PROFILE_TOP ? found++ : PROFILE_TOP - 1;
+        for (; j > 0 && counts[top[j - 1]].*field < v; j--) {
+            top[j] = top[j - 1];
+        }
+        top[j] = i;
+    }
+    return found;
+}
+
+void
+Profile::Print() const
+{
+    printf("Profile of %s:\n", name);
+
+    // Per function totals; index `numSymbols` gathers the code before the
+    // first symbol, or all of it if there are none.
+    PcCounts *totals = new PcCounts [numSymbols + 1];
+    memset(totals, 0, (numSymbols + 1) * sizeof *totals);
+    for (unsigned i = 0; i < numCounts; i++) {
+        int s = FindSymbol(i * 4);
+        PcCounts *t = &totals[s < 0 ? numSymbols : s];
+        t->instructions += counts[i].instructions;
+        t->blocks       += counts[i].blocks;
+        t->tlbMisses    += counts[i].tlbMisses;
+        t->pageFaults   += counts[i].pageFaults;
+    }
+    printf("    %12s %10s %10s %10s  %s\n",
+           "instructions", "blocks", "TLB misses", "faults", "function");
+    for (unsigned s = 0; s <= numSymbols; s++) {
+        const PcCounts *t = &totals[s];
+        if (t->instructions == 0 && t->tlbMisses == 0) {
+            continue;
+        }
+        printf("    %12lu %10lu %10lu %10lu  %s\n",
+               t->instructions, t->blocks, t->tlbMisses, t->pageFaults,
+               s < numSymbols ? symbols[s].name : "?");
+    }
+    delete [] totals;
+
+    unsigned top[PROFILE_TOP];
+    unsigned n;
+
+    printf("Hottest instructions:\n");
+    printf("    %12s %10s %10s  %s\n",
+           "instructions", "TLB misses", "faults", "address");
+    n = Hottest(&PcCounts::instructions, top);
+    for (unsigned i = 0; i < n; i++) {
+        const PcCounts *c = &counts[top[i]];
+        printf("    %12lu %10lu %10lu  ",
+               c->instructions, c->tlbMisses, c->pageFaults);
+        PrintLocation(top[i] * 4);
+        printf("\n");
+    }
+
+    printf("Hottest basic blocks:\n");
+    printf("    %12s  %s\n", "entries", "address");
+    n = Hottest(&PcCounts::blocks, top);
+    for (unsigned i = 0; i < n; i++) {
+        printf("    %12lu  ", counts[top[i]].blocks);
+        PrintLocation(top[i] * 4);
+        printf("\n");
+    }
+}
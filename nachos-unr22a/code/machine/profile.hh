@@ -0,0 +1,89 @@
+/// Data structures for profiling user programs.
+///
+/// A profile counts, for every instruction of a program, how many times it
+/// was run, how many times a basic block started at it, and how many TLB
+/// misses and page faults it caused.  Counts are exact: every instruction
+/// run is counted, nothing is sampled.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_PROFILE__HH
+#define NACHOS_MACHINE_PROFILE__HH
+
+
+/// How many of the hottest instructions and basic blocks are printed.
+const unsigned PROFILE_TOP = 10;
+
+class Profile {
+public:
+
+    /// Start an empty profile of the program `programName`.
+    Profile(const char *programName);
+
+    ~Profile();
+
+    const char *GetName() const;
+
+    /// Name the code starting at `address`, up to the next symbol.
+    void AddSymbol(unsigned address, const char *name);
+
+    /// Count a run of the instruction at `pc`, `prevPc` being the previous
+    /// one run by the same thread.
+    ///
+    /// A new basic block is counted whenever `prevPc` is not the
+    /// instruction right before, that is, after a jump or a branch taken.
+    /// An instruction retried after an exception is counted again, as it
+    /// takes time again, but does not start a block.
+    void CountInstruction(unsigned pc, unsigned prevPc);
+
+    void CountTlbMiss(unsigned pc);
+
+    void CountPageFault(unsigned pc);
+
+    /// Print the counts per function, and the hottest instructions and
+    /// basic blocks.
+    void Print() const;
+
+private:
+
+    struct PcCounts {
+        unsigned long instructions;
+        unsigned long blocks;  ///< Times a basic block started here.
+        unsigned long tlbMisses;
+        unsigned long pageFaults;
+    };
+
+    struct Symbol {
+        unsigned address;
+        char *name;
+    };
+
+    /// Counts of the instruction at `pc`, growing the table if needed.
+    PcCounts *At(unsigned pc);
+
+    /// Index in `symbols` of the function containing `pc`, or -1.
+    int FindSymbol(unsigned pc) const;
+
+    /// Fill `top` with the instructions with the highest `field` counts,
+    /// in descending order, and return how many there are (at most
+    /// `PROFILE_TOP`).
+    unsigned Hottest(unsigned long PcCounts::*field, unsigned *top) const;
+
+    /// Print `pc` as a function name plus an offset.
+    void PrintLocation(unsigned pc) const;
+
+    char *name;
+
+    PcCounts *counts;  ///< Indexed by instruction number (`pc / 4`).
+    unsigned numCounts;
+
+    Symbol *symbols;  ///< Sorted by address.
+    unsigned numSymbols;
+
+    unsigned lastPc;  ///< Last instruction counted, to tell retries.
+};
+
+
+#endif
@@ -21,6 +21,16 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numSwapReads = numSwapWrites = numCleanEvictions = 0;
+    numPagesPrefetched = numPrefetchHits = 0;
+    numPagesShared = numPagesCopiedOnWrite = 0;
+    numPageCacheHits = 0;
+    numZeroFillPages = numZeroPoolHits = 0;
+    numMappedPageReads = numMappedPageWrites = 0;
+    pagePolicy = nullptr;
+    TLBTotals = TLBMisses = TLBReplacements = 0;
+    TLBPolicy = nullptr;
+    numCpus = 1;
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
 #endif
@@ -40,13 +50,38 @@ Statistics::Print()
 #endif
     printf("Ticks: total %lu, idle %lu, system %lu, user %lu\n",
            totalTicks, idleTicks, systemTicks, userTicks);
+    if (numCpus > 1) {
+        printf("Processors: %u, average busy %.2f\n", numCpus,
+               totalTicks == 0 ? 0.0
+                 : (double) (systemTicks + userTicks) / totalTicks);
+    }
     printf("Disk I/O: reads %lu, writes %lu\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %lu, writes %lu\n",
            numConsoleCharsRead, numConsoleCharsWritten);
     printf("Paging: faults %lu\n", numPageFaults);
+    if (pagePolicy != nullptr) {
+        printf("Paging policy %s: faults %lu, swap reads %lu, swap writes %lu,"
+               " clean evictions %lu\n", pagePolicy, numPageFaults,
+               numSwapReads, numSwapWrites, numCleanEvictions);
+        printf("Fault-around: prefetched %lu, used %lu\n",
+               numPagesPrefetched, numPrefetchHits);
+        printf("Copy-on-write: pages shared %lu, copied %lu\n",
+               numPagesShared, numPagesCopiedOnWrite);
+        printf("Page cache: hits %lu\n", numPageCacheHits);
+        printf("Zero-fill: pages %lu, from the zeroed pool %lu\n",
+               numZeroFillPages, numZeroPoolHits);
+        printf("Mapped files: pages read %lu, written back %lu\n",
+               numMappedPageReads, numMappedPageWrites);
+    }
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
     printf("TBL Totals: %ld\n", TLBTotals);
     printf("TBL Misses: %ld\n", TLBMisses);
     printf("TBL Hit ratio: %f%%\n", ((float)(TLBTotals-TLBMisses)/(float)TLBTotals) * 100);
+    if (TLBPolicy != nullptr) {
+        printf("TLB policy %s: hit ratio %.2f%%, replacements %lu\n",
+               TLBPolicy, TLBTotals == 0 ? 0.0
+                 : 100.0 * (TLBTotals - TLBMisses) / TLBTotals,
+               TLBReplacements);
+    }
 }
@@ -47,6 +47,38 @@ public:
     /// Number of virtual memory page faults.
     unsigned long numPageFaults;
 
+    /// Page replacement policy in use, if pages are swapped, how many pages
+    /// were read from and written to swap, and how many were evicted clean,
+    /// without writing them.
+    const char *pagePolicy;
+    unsigned long numSwapReads;
+    unsigned long numSwapWrites;
+    unsigned long numCleanEvictions;
+
+    /// Pages loaded by fault-around ahead of a fault, and how many of them
+    /// were used before being evicted.
+    unsigned long numPagesPrefetched;
+    unsigned long numPrefetchHits;
+
+    /// Pages that `Fork` shared between parent and child instead of copying
+    /// them, and how many were copied later, when one of them wrote it.
+    unsigned long numPagesShared;
+    unsigned long numPagesCopiedOnWrite;
+
+    /// Code pages found in memory in the page cache, mapped without reading
+    /// them from the executable.
+    unsigned long numPageCacheHits;
+
+    /// Pages loaded the first time as zeros, without reading them, and how
+    /// many of them got a frame already filled with zeros.
+    unsigned long numZeroFillPages;
+    unsigned long numZeroPoolHits;
+
+    /// Pages of mapped files read from the file on a fault, and written
+    /// back to it when evicted or unmapped.
+    unsigned long numMappedPageReads;
+    unsigned long numMappedPageWrites;
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
@@ -57,6 +89,18 @@ public:
     unsigned long TLBTotals;
     unsigned long TLBMisses;
 
+    /// TLB replacement policy in use, if there is a TLB, and how many valid
+    /// entries it replaced.
+    const char *TLBPolicy;
+    unsigned long TLBReplacements;
+
+    /// Number of simulated processors.
+    ///
+    /// With more than one, `totalTicks` is the time elapsed on the processor
+    /// being simulated (the furthest one, once Nachos halts), while the
+    /// idle, system and user ticks add up the time of all processors.
+    unsigned numCpus;
+
 #ifdef DFS_TICKS_FIX
     /// Number of times the tick count gets reset.
     unsigned long tickResets;
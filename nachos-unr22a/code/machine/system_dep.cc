@@ -34,6 +34,7 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <sys/mman.h>
 #ifdef HOST_i386
@@ -181,6 +182,35 @@ Tell(int fd)
 #endif
 }
 
+/// Report the inode of an open file, which tells it apart from any other
+/// file on the same host file system.
+///
+/// Abort on error.
+unsigned long
+Inode(int fd)
+{
+    struct stat st;
+    int retVal = fstat(fd, &st);
+    ASSERT(retVal >= 0);
+    return st.st_ino;
+}
+
+/// Report a stamp of the contents of an open file, made from its length
+/// and the time it was last written.  It changes whenever the file is
+/// written, and a new file that reuses the inode of a removed one gets a
+/// different stamp.
+///
+/// Abort on error.
+unsigned long
+Version(int fd)
+{
+    struct stat st;
+    int retVal = fstat(fd, &st);
+    ASSERT(retVal >= 0);
+    return ((unsigned long) st.st_mtim.tv_sec * 1000000007UL
+            + st.st_mtim.tv_nsec) * 31 + st.st_size;
+}
+
 /// Close a file.
 ///
 /// Abort on error.
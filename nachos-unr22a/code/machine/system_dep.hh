@@ -41,6 +41,10 @@ namespace SystemDep {
 
     int Tell(int fd);
 
+    unsigned long Inode(int fd);
+
+    unsigned long Version(int fd);
+
     void Close(int fd);
 
     bool Unlink(const char *name);
@@ -42,15 +42,18 @@ TimerHandler(void *arg)
 /// * `callArg` is the parameter to be passed to the interrupt handler.
 /// * `doRandom` -- if true, arrange for the interrupts to occur at random,
 ///   instead of fixed, intervals.
-Timer::Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom)
+/// * `cpu` is the processor to interrupt, or `ANY_CPU`.
+Timer::Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom,
+             int cpu)
 {
     randomize = doRandom;
     handler   = timerHandler;
     arg       = callArg;
+    target    = cpu;
 
     // Schedule the first interrupt from the timer device.
     interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
-                        TIMER_INT);
+                        TIMER_INT, target);
 }
 
 /// Routine to simulate the interrupt generated by the hardware timer device.
@@ -61,7 +64,7 @@ Timer::TimerExpired()
 {
     // Schedule the next timer device interrupt.
     interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
-                        TIMER_INT);
+                        TIMER_INT, target);
 
     // Invoke the Nachos interrupt handler for this device.
     (*handler)(arg);
@@ -21,6 +21,7 @@
 #define NACHOS_MACHINE_TIMER__HH
 
 
+#include "interrupt.hh"
 #include "lib/utility.hh"
 
 
@@ -30,7 +31,11 @@ public:
 
     /// Initialize the timer, to call the interrupt handler `timerHandler`
     /// every time slice.
-    Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom);
+    ///
+    /// With several processors, each one has its own timer and `cpu` is
+    /// the one it interrupts.
+    Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom,
+          int cpu = ANY_CPU);
 
     ~Timer() {}
 
@@ -46,6 +51,7 @@ private:
     bool randomize;  ///< Set if we need to use a random timeout delay.
     VoidFunctionPtr handler;  ///< Timer interrupt handler.
     void *arg;  ///< Argument to pass to interrupt handler.
+    int target;  ///< Processor to interrupt, or `ANY_CPU`.
 
 };
 
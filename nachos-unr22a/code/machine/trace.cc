@@ -0,0 +1,210 @@
+/// Routines to record and replay the nondeterministic inputs of a run.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "trace.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static const char TRACE_MAGIC[8] = {
+    'N', 'A', 'C', 'H', 'O', 'S', 'T', 'R'
+};
+
+static const char *EVENT_NAMES[NUM_TRACE_EVENTS] = {
+    "console character", "packet", "random seed", "disk hash"
+};
+
+Trace::Trace(const char *fileName, bool replay)
+{
+    ASSERT(fileName != nullptr);
+
+    replaying = replay;
+    buffered = 0;
+    lastTick = 0;
+    events = nullptr;
+    eventsSize = 0;
+    position = 0;
+    hasNext = false;
+    nextTick = 0;
+
+    if (!replay) {
+        fileNo = SystemDep::OpenForWrite(fileName);
+        SystemDep::WriteFile(fileNo, TRACE_MAGIC, sizeof TRACE_MAGIC);
+        return;
+    }
+
+    fileNo = -1;
+    int fd = SystemDep::OpenForReadWrite(fileName, true);
+    SystemDep::Lseek(fd, 0, SEEK_END);
+    eventsSize = SystemDep::Tell(fd);
+    SystemDep::Lseek(fd, 0, SEEK_SET);
+    events = new char [eventsSize];
+    SystemDep::Read(fd, events, eventsSize);
+    SystemDep::Close(fd);
+    if (eventsSize < sizeof TRACE_MAGIC
+          || memcmp(events, TRACE_MAGIC, sizeof TRACE_MAGIC) != 0) {
+        printf("%s is not a trace, running with live inputs\n", fileName);
+        replaying = false;
+        return;
+    }
+    position = sizeof TRACE_MAGIC;
+    ReadNext();
+}
+
+Trace::~Trace()
+{
+    if (fileNo >= 0) {
+        SystemDep::Close(fileNo);
+    }
+    if (replaying && hasNext) {
+        printf("Replay ended before the %s recorded at tick %lu\n",
+               EVENT_NAMES[nextType], nextTick);
+    }
+    delete [] events;
+}
+
+bool
+Trace::IsReplaying() const
+{
+    return replaying;
+}
+
+void
+Trace::Flush()
+{
+    SystemDep::WriteFile(fileNo, buffer, buffered);
+    buffered = 0;
+}
+
+void
+Trace::WriteNumber(unsigned long n)
+{
+    do {
+        if (buffered == sizeof buffer) {
+            Flush();
+        }
+        buffer[buffered++] = (n & 0x7F) | (n > 0x7F ? 0x80 : 0);
+        n >>= 7;
+    } while (n != 0);
+}
+
+void
+Trace::Record(TraceEvent type, const char *data, unsigned size)
+{
+    ASSERT(type < NUM_TRACE_EVENTS);
+    ASSERT(data != nullptr);
+
+    if (fileNo < 0) {
+        return;
+    }
+
+    // With several processors the clock of each one is used, so ticks may
+    // go back; the difference is stored with its sign in the lowest bit.
+    unsigned long delta = stats->totalTicks >= lastTick
+                          ? (stats->totalTicks - lastTick) << 1
+                          : (lastTick - stats->totalTicks) << 1 | 1;
+    lastTick = stats->totalTicks;
+
+    WriteNumber(type);
+    WriteNumber(delta);
+    WriteNumber(size);
+    for (unsigned i = 0; i < size; i++) {
+        if (buffered == sizeof buffer) {
+            Flush();
+        }
+        buffer[buffered++] = data[i];
+    }
+    Flush();
+}
+
+/// Read an unsigned number written by `WriteNumber` from `events`,
+/// advancing `*position`.
+///
+/// Returns false if the trace ends first.
+static bool
+ReadNumber(const char *events, unsigned size, unsigned *position,
+           unsigned long *n)
+{
+    *n = 0;
+    for (unsigned shift = 0; *position < size; shift += 7) {
+        unsigned char byte = events[(*position)++];
+        *n |= (unsigned long) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+Trace::ReadNext()
+{
+    unsigned long type, delta, size;
+    hasNext = ReadNumber(events, eventsSize, &position, &type)
+              && ReadNumber(events, eventsSize, &position, &delta)
+              && ReadNumber(events, eventsSize, &position, &size)
+              && type < NUM_TRACE_EVENTS
+              && position + size <= eventsSize;
+    if (!hasNext) {
+        return;
+    }
+    nextType = (TraceEvent) type;
+    if (delta & 1) {
+        nextTick -= delta >> 1;
+    } else {
+        nextTick += delta >> 1;
+    }
+    nextData = &events[position];
+    nextSize = size;
+    position += size;
+}
+
+bool
+Trace::Replay(TraceEvent type, char *data, unsigned *size)
+{
+    ASSERT(type < NUM_TRACE_EVENTS);
+    ASSERT(data != nullptr);
+    ASSERT(size != nullptr);
+
+    if (!replaying || !hasNext || nextType != type
+          || nextTick != stats->totalTicks) {
+        return false;
+    }
+    ASSERT(nextSize <= *size);
+
+    memcpy(data, nextData, nextSize);
+    *size = nextSize;
+    DEBUG('i', "Replaying %s at tick %lu\n", EVENT_NAMES[type], nextTick);
+    ReadNext();
+    return true;
+}
+
+unsigned
+Trace::Seed(unsigned seed)
+{
+    unsigned size = sizeof seed;
+    if (!replaying) {
+        Record(TRACE_RANDOM_SEED, (char *) &seed, sizeof seed);
+    } else if (!Replay(TRACE_RANDOM_SEED, (char *) &seed, &size)) {
+        Diverge("no random seed in the trace");
+    }
+    return seed;
+}
+
+void
+Trace::Diverge(const char *reason)
+{
+    ASSERT(reason != nullptr);
+
+    if (!replaying) {
+        return;
+    }
+    printf("Replay diverged at tick %lu: %s\n", stats->totalTicks, reason);
+    replaying = false;
+}
@@ -0,0 +1,99 @@
+/// Data structures to record the nondeterministic inputs of a run, and to
+/// replay them.
+///
+/// Given the same inputs, the simulation is deterministic; what makes two
+/// runs differ is what comes from outside, at the moment it comes:
+/// characters typed at the console, packets arriving from the network,
+/// the pseudo-random numbers behind random yields and lossy links, and
+/// the contents of the disk.  A trace keeps each of those with the tick it
+/// arrived at, so that a run can be repeated exactly, for instance under
+/// the profiler, with the very same scheduling.
+///
+/// Pseudo-random numbers are all determined by the seed, so only the seed
+/// is kept; runs can last long enough to draw millions of them.
+///
+/// The trace is a host file made of a magic number followed by events.
+/// Every event is encoded in a few bytes: its type, the tick as a
+/// difference from the previous event, the size of its data and the data.
+/// Events are written out as they happen, so that the trace of a run that
+/// crashes is still good up to the crash.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_TRACE__HH
+#define NACHOS_MACHINE_TRACE__HH
+
+
+enum TraceEvent {
+    TRACE_CONSOLE_CHAR,  ///< A character read from the console.
+    TRACE_PACKET,        ///< A packet received from the network.
+    TRACE_RANDOM_SEED,   ///< Seed of the pseudo-random numbers.
+    TRACE_DISK_HASH,     ///< Hash of the contents of the disk.
+    NUM_TRACE_EVENTS
+};
+
+class Trace {
+public:
+
+    /// Record inputs to the host file `fileName`, or replay those recorded
+    /// in it if `replay` is true.
+    Trace(const char *fileName, bool replay);
+
+    /// Close the trace, warning if the replay did not use every input
+    /// recorded.
+    ~Trace();
+
+    /// Whether inputs come from the trace instead of the devices.
+    bool IsReplaying() const;
+
+    /// Record that `size` bytes of input of kind `type` arrived now.
+    void Record(TraceEvent type, const char *data, unsigned size);
+
+    /// Take the input of kind `type` that arrived now in the recorded run.
+    ///
+    /// Returns false if there was none; otherwise the input is copied to
+    /// `data`, and `*size` is set to its length, which must not be greater
+    /// than the value it had.
+    bool Replay(TraceEvent type, char *data, unsigned *size);
+
+    /// Seed for the pseudo-random numbers: `seed` is recorded, or the one
+    /// recorded is returned instead when replaying.
+    unsigned Seed(unsigned seed);
+
+    /// The run no longer follows the recording, because of `reason`:
+    /// report it and go on with live inputs.
+    void Diverge(const char *reason);
+
+private:
+
+    /// Read the next event in `events` into `next*`.
+    void ReadNext();
+
+    /// Append an unsigned number in as few bytes as needed.
+    void WriteNumber(unsigned long n);
+
+    /// Write out the event being recorded.
+    void Flush();
+
+    int fileNo;  ///< Trace file being recorded to.
+    bool replaying;
+
+    char buffer[256];  ///< Event being recorded.
+    unsigned buffered;
+    unsigned long lastTick;  ///< Tick of the last event.
+
+    char *events;  ///< Whole trace being replayed.
+    unsigned eventsSize;
+    unsigned position;  ///< Of the event after the next one.
+
+    bool hasNext;  ///< Whether there are events left to replay.
+    TraceEvent nextType;
+    unsigned long nextTick;
+    const char *nextData;
+    unsigned nextSize;
+};
+
+
+#endif
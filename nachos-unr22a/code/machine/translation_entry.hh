@@ -54,6 +54,13 @@ public:
     /// This bit is set by the hardware every time the page is modified.
     bool dirty;
 
+    /// Address space the translation belongs to.
+    ///
+    /// Only used in TLB entries: an entry only matches while the MMU runs
+    /// the address space with the same identifier, so entries of several
+    /// address spaces can be in the TLB at once.
+    unsigned asid;
+
 };
 
 
@@ -60,8 +60,9 @@ Lock::Release()
     ASSERT(IsHeldByCurrentThread());
     //* Si fue actualizada su prioridad.
     lockOwner->SetPriorityHerencia(lockOwner->GetOriginalPriority());
-    semaphore->V();
+    // Antes del V: puede despertar a otro thread que tome el lock antes de que volvamos.
     lockOwner = nullptr;
+    semaphore->V();
 }
 
 bool
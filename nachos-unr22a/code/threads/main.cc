@@ -11,8 +11,12 @@
 /// =====
 ///
 ///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
-///            [-rs <random seed #>] [-z] [-tt]
-///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
+///            [-rs <random seed #>] [-rec <trace>] [-play <trace>] [-z] [-tt]
+///            [-s] [-pf] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
+///            [-cpus <number of processors>] [-ps <page size>]
+///            [-frames <number of physical pages>] [-tlb <TLB entries>]
+///            [-tlbp <fifo | random | nru | lru>] [-fa <pages>]
+///            [-ck <checkpoint file> <time>] [-rc <checkpoint file>]
 ///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
 ///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
 ///            [-n <network reliability>] [-id <machine id>]
@@ -27,6 +31,12 @@
 ///            debugging messages.
 /// * `-p`  -- enables preemptive multitasking for kernel threads.
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
+/// * `-rec` -- records the inputs of the run (console, network, random
+///             seed and the disk) with the time they arrive, to a trace
+///             file.
+/// * `-play` -- replays the inputs recorded in a trace file instead of
+///              taking them from the devices, repeating the recorded run;
+///              give it the same other options as the recording.
 /// * `-z`  -- prints version and copyright information, and exits.
 ///
 /// *THREADS* options
@@ -39,8 +49,24 @@
 /// ----------------------
 ///
 /// * `-s`  -- causes user programs to be executed in single-step mode.
+/// * `-pf` -- profiles user programs, and prints how often each function
+///            and instruction ran when the machine halts.
 /// * `-x`  -- runs a user program.
 /// * `-tc` -- tests the console.
+/// * `-cpus` -- simulates a multiprocessor with the given number of
+///              processors (at most `MAX_CPUS`).
+/// * `-ps` -- sets the page size, in bytes (a power of two, at least 4).
+/// * `-frames` -- sets the size of physical memory, in pages.
+/// * `-tlb` -- sets the number of TLB entries.
+/// * `-tlbp` -- sets the TLB replacement policy: first in first out (the
+///              default), random, not recently used or pseudo-LRU.
+/// * `-fa` -- sets how many pages a page fault loads when pages are swapped:
+///            the faulting one and the following ones of its segment that
+///            are not in memory.  The default, 1, loads only the faulting
+///            page.
+/// * `-ck` -- saves the machine to a checkpoint file at the first system
+///            call made once simulated time reaches the given one.
+/// * `-rc` -- resumes the user program saved in a checkpoint file.
 ///
 /// *FILESYS* options
 /// -----------------
@@ -92,6 +118,7 @@ void Copy(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
 void PerformanceTest(void);
 void StartProcess(const char *file);
+void RestoreCheckpoint(const char *file);
 void ConsoleTest(const char *in, const char *out);
 void MailTest(int networkID);
 
@@ -143,6 +170,10 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-rc")) {  // Resume from a checkpoint.
+            ASSERT(argc > 1);
+            RestoreCheckpoint(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-tc")) {  // Test the console.
             if (argc == 1) {
                 ConsoleTest(nullptr, nullptr);
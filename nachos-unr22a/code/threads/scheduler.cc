@@ -12,6 +12,12 @@
 /// Very simple implementation -- no priorities, straight FIFO.  Might need
 /// to be improved in later assignments.
 ///
+/// With several processors, each one has its own ready lists, and the
+/// simulation moves from one to another at well defined points: between
+/// user instructions and when a processor runs out of threads.  So the
+/// single processor reasoning above still holds: kernel code runs on one
+/// processor at a time, as under a big kernel lock.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -21,30 +27,45 @@
 #include "scheduler.hh"
 #include "system.hh"
 
+#include <limits.h>
 #include <stdio.h>
 
 
 /// Initialize the list of ready but not running threads to empty.
-Scheduler::Scheduler()
+///
+/// * `cpus` is the number of processors.
+Scheduler::Scheduler(unsigned cpus)
 {
-    for (unsigned int i = 0; i <= MAX_PRIORITY; i++)
-    {
-        readyList[i] = new List<Thread *>;
+    ASSERT(cpus > 0 && cpus <= MAX_CPUS);
+
+    numCpus = cpus;
+    for (unsigned cpu = 0; cpu < MAX_CPUS; cpu++) {
+        for (unsigned int i = 0; i <= MAX_PRIORITY; i++)
+        {
+            readyList[cpu][i] = new List<Thread *>;
+        }
+        cpuThreads[cpu] = nullptr;
     }
+    idleWork = nullptr;
 }
 
 /// De-allocate the list of ready threads.
 Scheduler::~Scheduler()
 {
-    for (unsigned int i = 0; i <= MAX_PRIORITY; i++)
-    {
-        delete readyList[i];
+    for (unsigned cpu = 0; cpu < MAX_CPUS; cpu++) {
+        for (unsigned int i = 0; i <= MAX_PRIORITY; i++)
+        {
+            delete readyList[cpu][i];
+        }
     }
 }
 
 /// Mark a thread as ready, but not running.
 /// Put it on the ready list, for later scheduling onto the CPU.
 ///
+/// The thread goes back to the processor it last ran on, unless that one
+/// is busy and another one has nothing to do.
+///
 /// * `thread` is the thread to be put on the ready list.
 void
 Scheduler::ReadyToRun(Thread *thread)
@@ -53,25 +74,71 @@ Scheduler::ReadyToRun(Thread *thread)
 
     DEBUG('t', "Putting thread %s on ready list\n", thread->GetName());
 
+    unsigned cpu = thread->cpu;
+    if (numCpus > 1 && (GetCpuThread(cpu) != nullptr || HasReadyThreads(cpu))) {
+        for (unsigned i = 0; i < numCpus; i++) {
+            if (GetCpuThread(i) == nullptr && !HasReadyThreads(i)) {
+                cpu = i;
+                break;
+            }
+        }
+    }
+
     thread->SetStatus(READY);
-    readyList[thread->GetPriority()]->Append(thread);
+    thread->cpu = cpu;
+    readyList[cpu][thread->GetPriority()]->Append(thread);
 }
 
 /// Return the next thread to be scheduled onto the CPU.
 ///
-/// If there are no ready threads, return null.
+/// If the current processor has no ready threads, take one from another
+/// processor.  If there are no ready threads at all, return null.
 ///
 /// Side effect: thread is removed from the ready list.
 Thread *
 Scheduler::FindNextToRun()
+{
+    unsigned current = interrupt->GetCpu();
+    Thread *thread = PopReady(current);
+    for (unsigned i = 1; thread == nullptr && i < numCpus; i++) {
+        thread = PopReady((current + i) % numCpus);
+    }
+    return thread;
+}
+
+void
+Scheduler::SetIdleWork(bool (*work)())
+{
+    idleWork = work;
+}
+
+bool
+Scheduler::StartIdleWork()
+{
+    return idleWork != nullptr && idleWork();
+}
+
+bool
+Scheduler::HasReadyThreads(unsigned cpu) const
+{
+    for (unsigned int i = 0; i <= MAX_PRIORITY; i++) {
+        if (!readyList[cpu][i]->IsEmpty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Thread *
+Scheduler::PopReady(unsigned cpu)
 {
     for (unsigned int i = 0; i <= MAX_PRIORITY; i++)
     {
-        if (!readyList[i]->IsEmpty()) {
-            return readyList[i]->Pop();
+        if (!readyList[cpu][i]->IsEmpty()) {
+            return readyList[cpu][i]->Pop();
         }
     }
-    return readyList[0]->Pop();
+    return nullptr;
 }
 
 /// Dispatch the CPU to `nextThread`.
@@ -105,10 +172,23 @@ Scheduler::Run(Thread *nextThread)
 
     currentThread = nextThread;  // Switch to the next thread.
     currentThread->SetStatus(RUNNING);  // `nextThread` is now running.
+    currentThread->cpu = interrupt->GetCpu();
 
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
           oldThread->GetName(), nextThread->GetName());
 
+    SwitchTo(oldThread, nextThread, true);
+}
+
+/// Do the actual context switch from `oldThread` to `nextThread`.
+///
+/// When `oldThread` is switched back to, delete the thread that was
+/// finishing, if any, and if `restoreUser` is set, restore the user state
+/// of `oldThread`.  It is not set when `oldThread` kept its processor, and
+/// thus its registers and TLB, while the simulation was elsewhere.
+void
+Scheduler::SwitchTo(Thread *oldThread, Thread *nextThread, bool restoreUser)
+{
     // This is a machine-dependent assembly language routine defined in
     // `switch.s`.  You may have to think a bit to figure out what happens
     // after this, both from the point of view of the thread and from the
@@ -122,14 +202,18 @@ Scheduler::Run(Thread *nextThread)
     // need to delete its carcass.  Note we cannot delete the thread before
     // now (for example, in `Thread::Finish`), because up to this point, we
     // were still running on the old thread's stack!
+    //
+    // Deleting its address space can block, and the threads that run
+    // meanwhile come through here too: forget it before deleting it.
     if (threadToBeDestroyed != nullptr) {
         DEBUG('t', "Now in thread \"%s\"\n", currentThread->GetName());
-        delete threadToBeDestroyed;
+        Thread *finished = threadToBeDestroyed;
         threadToBeDestroyed = nullptr;
+        delete finished;
     }
 
 #ifdef USER_PROGRAM
-    if (currentThread->space != nullptr) {
+    if (restoreUser && currentThread->space != nullptr) {
         // If there is an address space to restore, do it.
         currentThread->RestoreUserState();
         currentThread->space->RestoreState();
@@ -137,6 +221,136 @@ Scheduler::Run(Thread *nextThread)
 #endif
 }
 
+unsigned
+Scheduler::GetNumCpus() const
+{
+    return numCpus;
+}
+
+Thread *
+Scheduler::GetCpuThread(unsigned cpu) const
+{
+    ASSERT(cpu < numCpus);
+    return cpu == interrupt->GetCpu() ? currentThread : cpuThreads[cpu];
+}
+
+/// Choose the processor to simulate next: the one furthest behind in time,
+/// among those with a running thread and the idle ones with ready threads
+/// (for which time can jump forward to now).  On ties, other processors go
+/// first, in round robin order.
+///
+/// * `leaving` -- if true, the current processor is not a candidate, and
+///   only busy processors are; the current one is returned if there is
+///   none.
+unsigned
+Scheduler::PickCpu(bool leaving) const
+{
+    unsigned current = interrupt->GetCpu();
+    unsigned best = current;
+    unsigned long bestTicks = leaving ? ULONG_MAX : stats->totalTicks;
+
+    for (unsigned i = 1; i < numCpus; i++) {
+        unsigned cpu = (current + i) % numCpus;
+        unsigned long ticks = interrupt->GetCpuTicks(cpu);
+        if (cpuThreads[cpu] == nullptr) {
+            if (leaving || !HasReadyThreads(cpu)) {
+                continue;
+            }
+            if (ticks < stats->totalTicks) {
+                ticks = stats->totalTicks;
+            }
+        }
+        if (ticks < bestTicks || (best == current && ticks == bestTicks)) {
+            best = cpu;
+            bestTicks = ticks;
+        }
+    }
+    return best;
+}
+
+void
+Scheduler::SelectCpu(unsigned cpu, bool wasIdle)
+{
+    interrupt->SelectCpu(cpu, wasIdle);
+#ifdef USER_PROGRAM
+    machine->SelectCpu(cpu);
+#endif
+}
+
+/// Give another processor the chance to run.
+///
+/// Called by `Machine::Run` between two user instructions.  The current
+/// thread keeps its processor, with its registers and TLB, and resumes
+/// when the simulation comes back to it.  If the next processor was idle,
+/// it is dispatched its first ready thread.
+void
+Scheduler::SwitchCpu()
+{
+    unsigned cpu = PickCpu(false);
+    if (cpu == interrupt->GetCpu()) {
+        return;
+    }
+
+    Thread *oldThread = currentThread;
+    Thread *nextThread = cpuThreads[cpu];
+    bool wasIdle = nextThread == nullptr;
+    if (wasIdle) {
+        nextThread = PopReady(cpu);
+        nextThread->SetStatus(RUNNING);
+        nextThread->cpu = cpu;
+    }
+
+    oldThread->CheckOverflow();
+    cpuThreads[interrupt->GetCpu()] = oldThread;
+    cpuThreads[cpu] = nullptr;
+    SelectCpu(cpu, wasIdle);
+    currentThread = nextThread;
+
+    DEBUG('t', "Switching to processor %u, thread \"%s\"\n",
+          cpu, nextThread->GetName());
+
+    SwitchTo(oldThread, nextThread, false);
+}
+
+/// The current thread is going to sleep and there is no ready thread
+/// anywhere: leave this processor idle and go on with another one that is
+/// running a thread.
+///
+/// Returns false if there is none, that is, if every processor is idle;
+/// otherwise, returns once the current thread was woken up and dispatched
+/// again, maybe on another processor.
+bool
+Scheduler::IdleCpu()
+{
+    if (numCpus == 1) {
+        return false;
+    }
+    unsigned cpu = PickCpu(true);
+    if (cpu == interrupt->GetCpu()) {
+        return false;
+    }
+
+    Thread *oldThread = currentThread;
+#ifdef USER_PROGRAM
+    if (oldThread->space != nullptr) {
+        oldThread->SaveUserState();
+        oldThread->space->SaveState();
+    }
+#endif
+    oldThread->CheckOverflow();
+
+    cpuThreads[interrupt->GetCpu()] = nullptr;
+    currentThread = cpuThreads[cpu];
+    cpuThreads[cpu] = nullptr;
+    SelectCpu(cpu, false);
+
+    DEBUG('t', "Processor idle, switching to processor %u, thread \"%s\"\n",
+          cpu, currentThread->GetName());
+
+    SwitchTo(oldThread, currentThread, true);
+    return true;
+}
+
 /// Print the scheduler state -- in other words, the contents of the ready
 /// list.
 ///
@@ -151,8 +365,10 @@ ThreadPrint(Thread *t)
 void
 Scheduler::Print()
 {
-    for (unsigned int i = 0; i <= MAX_PRIORITY; i++)
-    {
-        readyList[i]->Apply(ThreadPrint);
+    for (unsigned cpu = 0; cpu < numCpus; cpu++) {
+        for (unsigned int i = 0; i <= MAX_PRIORITY; i++)
+        {
+            readyList[cpu][i]->Apply(ThreadPrint);
+        }
     }
 }
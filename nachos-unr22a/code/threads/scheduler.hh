@@ -13,6 +13,7 @@
 
 #include "thread.hh"
 #include "lib/list.hh"
+#include "machine/interrupt.hh"
 
 unsigned const MAX_PRIORITY = 5;
 
@@ -23,7 +24,7 @@ class Scheduler {
 public:
 
     /// Initialize list of ready threads.
-    Scheduler();
+    Scheduler(unsigned cpus = 1);
 
     /// De-allocate ready list.
     ~Scheduler();
@@ -42,11 +43,64 @@ public:
 
     void updatePriority( );
 
+    /// Multiprocessor support.
+    ///
+    /// Each processor has its own ready lists and runs one thread at a time;
+    /// `currentThread` is the thread of the processor being simulated.  The
+    /// simulation moves from one processor to another only between user
+    /// instructions (`SwitchCpu`) or when a processor runs out of threads
+    /// (`IdleCpu`), so kernel code never runs on two processors at once.
+
+    /// Number of processors.
+    unsigned GetNumCpus() const;
+
+    /// Thread running on processor `cpu`, null if it is idle.
+    Thread *GetCpuThread(unsigned cpu) const;
+
+    /// Let the processor that is furthest behind in time run for a while.
+    void SwitchCpu();
+
+    /// Leave the current processor idle and go on with another one.
+    bool IdleCpu();
+
+    /// Whether processor `cpu` has threads in its ready lists.
+    bool HasReadyThreads(unsigned cpu) const;
+
+    /// Set `work` to be called when a processor runs out of ready threads,
+    /// before it goes idle.  It can make ready a thread that does work
+    /// that can wait for such a moment, and returns whether it did.  It is
+    /// called with interrupts disabled, so it must not block.
+    void SetIdleWork(bool (*work)());
+
+    /// Call the idle work, if any.  Returns whether it made a thread ready.
+    bool StartIdleWork();
+
 private:
 
+    /// Switch the simulation to processor `cpu`.
+    void SelectCpu(unsigned cpu, bool wasIdle);
+
+    /// Processor that should run next, other than the current one, or the
+    /// current one if none is behind it.
+    unsigned PickCpu(bool onlyBusy) const;
+
+    /// Take the first thread from the ready lists of processor `cpu`.
+    Thread *PopReady(unsigned cpu);
+
+    /// Switch to `nextThread`, and finish the job when we are switched
+    /// back to.
+    void SwitchTo(Thread *oldThread, Thread *nextThread, bool restoreUser);
+
+    unsigned numCpus;
+
     // Queue of threads that are ready to run, but not running.
     //? List<Thread*> *readyList;
-    List<Thread*> *readyList[MAX_PRIORITY + 1];
+    List<Thread*> *readyList[MAX_CPUS][MAX_PRIORITY + 1];
+
+    /// Thread running on each processor, null if it is idle.
+    Thread *cpuThreads[MAX_CPUS];
+
+    bool (*idleWork)();
 
 };
 
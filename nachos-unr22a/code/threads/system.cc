@@ -11,8 +11,12 @@
 #include "lock.hh"
 
 #ifdef USER_PROGRAM
+#include "userprog/address_space.hh"
+#include "userprog/checkpoint.hh"
 #include "userprog/debugger.hh"
 #include "userprog/exception.hh"
+#include "userprog/profiler.hh"
+#include "userprog/tlb_policy.hh"
 #endif
 
 #include <stdlib.h>
@@ -30,6 +34,9 @@ Interrupt *interrupt;         ///< Interrupt status.
 Statistics *stats;            ///< Performance metrics.
 Timer *timer;                 ///< The hardware timer device, for invoking
                               ///< context switches.
+static Timer *cpuTimers[MAX_CPUS];  ///< Timers of the other processors.
+Trace *trace = nullptr;       ///< Nondeterministic inputs being recorded or
+                              ///< replayed.
 
 Table<Thread*> *userThreads;
 Lock *userThreadsLock;
@@ -48,6 +55,8 @@ SynchDisk *synchDisk;
 
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
 Machine *machine;  ///< User program memory and registers.
+Profiler *profiler = nullptr;  ///< Profiles of user programs, if enabled.
+TlbPolicy *tlbPolicy = nullptr;  ///< Replacement policy of the TLBs, if any.
 #endif
 
 #ifdef NETWORK
@@ -74,6 +83,12 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(void *dummy)
 {
+#if defined(USER_PROGRAM) && defined(SWAP) && defined(PV_POLICY_AGING)
+    // Once per period, however many processors there are.
+    if (interrupt->GetCpu() == 0) {
+        SampleReferenceBits();
+    }
+#endif
     if (interrupt->GetStatus() != IDLE_MODE) {
         interrupt->YieldOnReturn();
     }
@@ -133,13 +148,25 @@ Initialize(int argc, char **argv)
     const char *debugFlags = "";
     DebugOpts debugOpts;
     bool randomYield = false;
+    unsigned seed = 1;  // The default of `srand`.
 
     // 2007, Jose Miguel Santos Espino
     bool preemptiveScheduling = false;
     long long timeSlice;
 
+    unsigned numCpus = 1;
+    const char *traceFile = nullptr;  // Trace to record or replay.
+    bool replay = false;
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    bool profileUserProg = false;  // Count user instructions per address.
+    unsigned pageSize = PAGE_SIZE;  // Size of the simulated machine.
+    unsigned numPhysPages = NUM_PHYS_PAGES;
+    unsigned tlbSize = TLB_SIZE;
+    TlbPolicyKind tlbPolicyKind = TLB_POLICY_FIFO;
+#endif
+#if defined(USER_PROGRAM) && defined(FILESYS)
+    const char *restoreFile = nullptr;  // Checkpoint to take the disk from.
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
@@ -165,10 +192,16 @@ Initialize(int argc, char **argv)
             argCount = 2;
         } else if (!strcmp(*argv, "-rs")) {
             ASSERT(argc > 1);
-            SystemDep::RandomInit(atoi(*(argv + 1)));
+            seed = atoi(*(argv + 1));
+            SystemDep::RandomInit(seed);
               // Initialize pseudo-random number generator.
             randomYield = true;
             argCount = 2;
+        } else if (!strcmp(*argv, "-rec") || !strcmp(*argv, "-play")) {
+            ASSERT(argc > 1);
+            traceFile = *(argv + 1);
+            replay = !strcmp(*argv, "-play");
+            argCount = 2;
         }
         // 2007, Jose Miguel Santos Espino
         else if (!strcmp(*argv, "-p")) {
@@ -183,6 +216,47 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s")) {
             debugUserProg = true;
+        } else if (!strcmp(*argv, "-pf")) {
+            profileUserProg = true;
+        } else if (!strcmp(*argv, "-ps")) {
+            ASSERT(argc > 1);
+            pageSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-frames")) {
+            ASSERT(argc > 1);
+            numPhysPages = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlb")) {
+            ASSERT(argc > 1);
+            tlbSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlbp")) {
+            ASSERT(argc > 1);
+            ASSERT(TlbPolicy::Parse(*(argv + 1), &tlbPolicyKind));
+            argCount = 2;
+#ifdef SWAP
+        } else if (!strcmp(*argv, "-fa")) {
+            ASSERT(argc > 1);
+            faultAroundPages = atoi(*(argv + 1));
+            ASSERT(faultAroundPages > 0);
+            argCount = 2;
+#endif
+        } else if (!strcmp(*argv, "-cpus")) {
+            ASSERT(argc > 1);
+            numCpus = atoi(*(argv + 1));
+            ASSERT(numCpus > 0 && numCpus <= MAX_CPUS);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ck")) {
+            ASSERT(argc > 2);
+            ScheduleCheckpoint(*(argv + 1), atol(*(argv + 2)));
+            argCount = 3;
+        }
+#endif
+#if defined(USER_PROGRAM) && defined(FILESYS)
+        if (!strcmp(*argv, "-rc")) {
+            ASSERT(argc > 1);
+            restoreFile = *(argv + 1);
+            argCount = 2;
         }
 #endif
 #ifdef FILESYS_NEEDED
@@ -206,9 +280,23 @@ Initialize(int argc, char **argv)
     debug.SetFlags(debugFlags);  // Initialize `DEBUG` messages.
     debug.SetOpts(debugOpts);    // Set debugging behavior.
     stats = new Statistics;      // Collect statistics.
+    stats->numCpus = numCpus;
+    if (traceFile != nullptr) {  // Before any input is taken.
+        trace = new Trace(traceFile, replay);
+        SystemDep::RandomInit(trace->Seed(seed));
+    }
     interrupt = new Interrupt;   // Start up interrupt handling.
-    scheduler = new Scheduler;   // Initialize the ready queue.
-    timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    scheduler = new Scheduler(numCpus);  // Initialize the ready queues.
+    if (numCpus == 1) {
+        timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    } else {
+        // Every processor has its own timer.
+        timer = new Timer(TimerInterruptHandler, 0, randomYield, 0);
+        for (unsigned cpu = 1; cpu < numCpus; cpu++) {
+            cpuTimers[cpu] = new Timer(TimerInterruptHandler, 0,
+                                       randomYield, cpu);
+        }
+    }
 
     threadToBeDestroyed = nullptr;
 
@@ -229,14 +317,30 @@ Initialize(int argc, char **argv)
     }
 
     userThreads = new Table<Thread*>();
+    // El pid 0 no es de nadie: es lo que `Fork` le devuelve al hijo, que tiene que poder distinguirse del padre.
+    userThreads->Add(nullptr);
     userThreadsLock = new Lock("userThreadsLock");
 #ifdef USER_PROGRAM
     Debugger *d = debugUserProg ? new Debugger : nullptr;
-    machine = new Machine(d);  // This must come first.
+    ASSERT(SetMachineSize(pageSize, numPhysPages, tlbSize));
+    machine = new Machine(d, numCpus);  // This must come first.
+    InitFrameTables();
     SetExceptionHandlers();
+    if (profileUserProg) {
+        profiler = new Profiler;
+    }
+#ifdef USE_TLB
+    tlbPolicy = new TlbPolicy(tlbPolicyKind, numCpus);
+    stats->TLBPolicy = tlbPolicy->GetName();
+#endif
 #endif
 
 #ifdef FILESYS
+#ifdef USER_PROGRAM
+    if (restoreFile != nullptr) {
+        RestoreCheckpointDisk(restoreFile);  // Before the disk is opened.
+    }
+#endif
     synchDisk = new SynchDisk("DISK");
 #endif
 
@@ -263,6 +367,8 @@ Cleanup()
 #endif
 
 #ifdef USER_PROGRAM
+    delete profiler;
+    delete tlbPolicy;
     delete machine;
 #endif
 
@@ -275,8 +381,12 @@ Cleanup()
 #endif
 
     delete timer;
+    for (unsigned cpu = 1; cpu < MAX_CPUS; cpu++) {
+        delete cpuTimers[cpu];
+    }
     delete scheduler;
     delete interrupt;
+    delete trace;
     delete userThreads;
     delete userThreadsLock;
 
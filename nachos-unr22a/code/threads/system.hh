@@ -15,6 +15,7 @@
 #include "machine/interrupt.hh"
 #include "machine/statistics.hh"
 #include "machine/timer.hh"
+#include "machine/trace.hh"
 
 
 /// Initialization and cleanup routines.
@@ -32,6 +33,7 @@ extern Scheduler *scheduler;         ///< The ready list.
 extern Interrupt *interrupt;         ///< Interrupt status.
 extern Statistics *stats;            ///< Performance metrics.
 extern Timer *timer;                 ///< The hardware alarm clock.
+extern Trace *trace;                 ///< Inputs recorded or replayed, if any.
 
 #include "lib/table.hh"
 #include "threads/lock.hh"
@@ -41,6 +43,10 @@ extern Lock *userThreadsLock;
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
 extern Machine *machine;  // User program memory and registers.
+#include "userprog/profiler.hh"
+extern Profiler *profiler;  // Profiles of user programs, if enabled.
+#include "userprog/tlb_policy.hh"
+extern TlbPolicy *tlbPolicy;  // Replacement policy of the TLBs, if any.
 #endif
 
 #ifdef FILESYS_NEEDED  // *FILESYS* or *FILESYS_STUB*.
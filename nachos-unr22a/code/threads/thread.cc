@@ -49,6 +49,7 @@ Thread::Thread(const char *threadName, bool joinable_, unsigned int priority_)
     stack    = nullptr;
     status   = JUST_CREATED;
     joinable = joinable_;
+    cpu      = 0;
     openFiles = new Table<OpenFile*>();
     // Para que los fid de la consola siempre esten abiertos para todos
     openFiles->Add(nullptr);
@@ -330,6 +331,13 @@ Thread::Sleep()
     Thread *nextThread;
     status = BLOCKED;
     while ((nextThread = scheduler->FindNextToRun()) == nullptr) {
+        if (scheduler->StartIdleWork()) {
+            continue;  // Something to do before idling.
+        }
+        if (scheduler->IdleCpu()) {
+            return;  // Another processor was running; we have been
+                     // signalled since.
+        }
         interrupt->Idle();  // No one to run, wait for an interrupt.
     }
 
@@ -153,6 +153,9 @@ public:
 
     unsigned currentDirectory = 1;
 
+    /// Processor this thread runs on, or last ran or was queued on.
+    unsigned cpu;
+
 private:
     // Some of the private data for this class is listed above.
 
@@ -0,0 +1,85 @@
+/// Test program for `Fork`.
+///
+/// Parent and child start with the same memory, and from then on neither
+/// sees what the other writes: both the global data and the stack are
+/// copied, right away or on the first write.  The child never gets the
+/// identifier 0, which is what `Fork` returns on its side.
+///
+/// Prints `forktest: ok` if every check passes.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+/// Several pages, so that more than one gets copied.
+#define SIZE  300
+
+static char data[SIZE];
+
+static void
+Fill(char *buffer, char c)
+{
+    for (unsigned i = 0; i < SIZE; i++) {
+        buffer[i] = c;
+    }
+}
+
+static bool
+AllEqual(const char *buffer, char c)
+{
+    for (unsigned i = 0; i < SIZE; i++) {
+        if (buffer[i] != c) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int
+Fail(const char *why)
+{
+    Nputs("forktest: ");
+    Nputs(why);
+    Nputs("\n");
+    return 1;
+}
+
+int
+main(void)
+{
+    char local[SIZE];
+    Fill(data, 'p');
+    Fill(local, 'p');
+
+    SpaceId child = Fork(true);
+    if (child < 0) {
+        return Fail("no se pudo crear el hijo");
+    }
+    if (child == 0) {
+        // Ve la memoria del padre como estaba en el Fork, aunque el padre ya la haya vuelto a escribir.
+        if (!AllEqual(data, 'p') || !AllEqual(local, 'p')) {
+            Exit(1);
+        }
+        Fill(data, 'h');
+        Fill(local, 'h');
+        if (!AllEqual(data, 'h') || !AllEqual(local, 'h')) {
+            Exit(2);
+        }
+        Exit(0);
+    }
+
+    Fill(data, 'P');
+    int status = Join(child);
+    if (status == 1) {
+        return Fail("el hijo no ve la memoria del padre al momento del Fork");
+    }
+    if (status != 0) {
+        return Fail("el hijo no puede escribir su copia de la memoria");
+    }
+    if (!AllEqual(data, 'P') || !AllEqual(local, 'p')) {
+        return Fail("el padre ve lo que escribio el hijo");
+    }
+    Nputs("forktest: ok\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+/// Test program for `Sbrk` and the allocator in `lib.c`.
+///
+/// The heap grows by whole pages of zeros.  `Nmalloc` hands out aligned
+/// blocks that do not overlap, from every size class and past the largest
+/// one, and gives a block back to the next request of its class once it
+/// is released with `Nfree`.
+///
+/// Prints `heaptest: ok` if every check passes.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+/// Sizes in every class of `Nmalloc`, at both ends of the smaller ones,
+/// and past the largest class.  All of them fit in the default memory of a
+/// kernel without virtual memory.
+static const unsigned SIZES[] = {
+    1, 8, 9, 24, 25, 56, 57, 120, 121, 248, 249, 504, 1016, 2040, 2041, 2600
+};
+#define NUM_SIZES  (sizeof SIZES / sizeof *SIZES)
+
+static int
+Fail(const char *why)
+{
+    Nputs("heaptest: ");
+    Nputs(why);
+    Nputs("\n");
+    return 1;
+}
+
+int
+main(void)
+{
+    char *start = Sbrk(0);
+    if (start == 0) {
+        return Fail("Sbrk(0) no devuelve el fin del heap");
+    }
+    if (Sbrk(-1) != 0) {
+        return Fail("Sbrk achica el heap");
+    }
+    if (Sbrk(1000) != start) {
+        return Fail("Sbrk no devuelve el fin del heap anterior");
+    }
+    char *end = Sbrk(0);
+    if (end - start < 1000) {
+        return Fail("el heap no crecio lo pedido");
+    }
+    for (char *p = start; p < end; p++) {
+        if (*p != 0) {
+            return Fail("la memoria nueva no esta en cero");
+        }
+        *p = 1;
+    }
+
+    if (Nmalloc(0) != 0) {
+        return Fail("Nmalloc(0) devuelve un bloque");
+    }
+    char *blocks[NUM_SIZES];
+    for (unsigned i = 0; i < NUM_SIZES; i++) {
+        blocks[i] = Nmalloc(SIZES[i]);
+        if (blocks[i] == 0) {
+            return Fail("Nmalloc no devuelve un bloque");
+        }
+        if ((unsigned) blocks[i] % 8 != 0) {
+            return Fail("un bloque no esta alineado");
+        }
+        for (unsigned j = 0; j < SIZES[i]; j++) {
+            blocks[i][j] = i;
+        }
+    }
+    for (unsigned i = 0; i < NUM_SIZES; i++) {
+        for (unsigned j = 0; j < SIZES[i]; j++) {
+            if (blocks[i][j] != (char) i) {
+                return Fail("dos bloques se pisan");
+            }
+        }
+    }
+
+    // Un bloque liberado es el proximo de su clase, y no sirve para otra.
+    for (unsigned i = 0; i < NUM_SIZES; i++) {
+        Nfree(blocks[i]);
+        if (Nmalloc(SIZES[i]) != blocks[i]) {
+            return Fail("no se reusa un bloque liberado de la misma clase");
+        }
+    }
+    Nfree(blocks[0]);
+    char *other = Nmalloc(SIZES[2]);
+    if (other == blocks[0]) {
+        return Fail("se reusa un bloque de otra clase");
+    }
+    if (Nmalloc(SIZES[1]) != blocks[0]) {
+        return Fail("no se reusa un bloque liberado de la misma clase");
+    }
+    // Los grandes sirven para cualquier pedido grande que entre.
+    Nfree(blocks[NUM_SIZES - 1]);
+    if (Nmalloc(2500) != blocks[NUM_SIZES - 1]) {
+        return Fail("no se reusa un bloque grande liberado");
+    }
+
+    Nputs("heaptest: ok\n");
+    return 0;
+}
@@ -28,4 +28,97 @@ void Nitoa (int n , char *st ) {
         st[j] = buff[i - j - 1];
     }
     st[j] = '\0';
+}
+
+// Memoria dinamica: Nmalloc y Nfree.
+//
+// Los bloques de hasta HEAP_MAX_CLASS bytes se redondean a una clase de tamanio, una potencia de dos desde
+// HEAP_MIN_CLASS, y al liberarse quedan en una lista por clase para el proximo pedido de la misma clase. Los mas
+// grandes quedan todos en otra lista, y se reusan para cualquier pedido que entre. Los bloques nuevos se toman
+// del final del heap, que se agranda con Sbrk solo cuando hace falta: las paginas que nunca se usan no ocupan
+// memoria.
+
+#define HEAP_MIN_CLASS     16
+#define HEAP_NUM_CLASSES   8    // 16, 32, ..., 2048 bytes.
+#define HEAP_MAX_CLASS     (HEAP_MIN_CLASS << (HEAP_NUM_CLASSES - 1))
+
+// Cabecera de cada bloque, justo antes de la memoria que se entrega. Ocupa 8 bytes, asi la memoria queda alineada.
+typedef struct HeapBlock {
+    unsigned int size;          // Bytes del bloque, con la cabecera.
+    struct HeapBlock *next;     // Siguiente bloque libre de la misma lista.
+} HeapBlock;
+
+static HeapBlock *heapFree[HEAP_NUM_CLASSES + 1];  // La ultima lista es la de los bloques grandes.
+static char *heapNext = 0;  // Primer byte del heap que todavia no es de ningun bloque.
+static char *heapEnd = 0;
+
+// Clase de un bloque de `size` bytes; HEAP_NUM_CLASSES si es grande.
+static unsigned int HeapClass (unsigned int size) {
+    unsigned int c = 0;
+    while (c < HEAP_NUM_CLASSES && (HEAP_MIN_CLASS << c) < size) {
+        c++;
+    }
+    return c;
+}
+
+// Toma un bloque de `size` bytes del final del heap, agrandandolo si hace falta.
+static HeapBlock *HeapCarve (unsigned int size) {
+    if (heapEnd == 0) {
+        heapNext = heapEnd = Sbrk(0);
+    }
+    if ((unsigned int) (heapEnd - heapNext) < size) {
+        char *grown = Sbrk(size);
+        if (grown == 0) {
+            return 0;
+        }
+        if (grown != heapEnd) {
+            // Alguien mas uso Sbrk: lo que sobraba no sigue al heap nuevo, se pierde.
+            heapNext = grown;
+        }
+        heapEnd = Sbrk(0);
+    }
+    HeapBlock *block = (HeapBlock *) heapNext;
+    heapNext += size;
+    block->size = size;
+    return block;
+}
+
+void *Nmalloc (unsigned int size) {
+    if (size == 0 || size > 0x7FFFFFF0) {
+        return 0;
+    }
+    unsigned int total = (size + sizeof (HeapBlock) + 7) & ~7u;
+    unsigned int c = HeapClass(total);
+    HeapBlock *block;
+    if (c < HEAP_NUM_CLASSES) {
+        block = heapFree[c];
+        if (block != 0) {
+            heapFree[c] = block->next;
+        } else {
+            block = HeapCarve(HEAP_MIN_CLASS << c);
+        }
+    } else {
+        // El primero que entre.
+        HeapBlock **link = &heapFree[HEAP_NUM_CLASSES];
+        while (*link != 0 && (*link)->size < total) {
+            link = &(*link)->next;
+        }
+        block = *link;
+        if (block != 0) {
+            *link = block->next;
+        } else {
+            block = HeapCarve(total);
+        }
+    }
+    return block != 0 ? block + 1 : 0;
+}
+
+void Nfree (void *p) {
+    if (p == 0) {
+        return;
+    }
+    HeapBlock *block = (HeapBlock *) p - 1;
+    unsigned int c = HeapClass(block->size);
+    block->next = heapFree[c];
+    heapFree[c] = block;
 }
\ No newline at end of file
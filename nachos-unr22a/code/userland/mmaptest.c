@@ -0,0 +1,119 @@
+/// Test program for `Mmap` and `Munmap`.
+///
+/// A mapped file reads as its contents, and what is written through the
+/// mapping gets to the file after `Munmap`, and also when a process exits
+/// with the file still mapped.  Only works in a kernel with virtual memory
+/// (`vmem`); the others refuse to map files.
+///
+/// Prints `mmaptest: ok` if every check passes.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+#define FILE_NAME  "mmaptest.txt"
+
+/// More than two pages, so that the last one is only partly mapped.
+#define SIZE  300
+
+static char buffer[SIZE];
+
+/// Byte `i` of the file after writing it with `first`: the letters or the
+/// digits from `first`, over and over.
+static char
+Expected(unsigned i, char first)
+{
+    return first == '0' ? first + i % 10 : first + i % 26;
+}
+
+static bool
+CheckFile(char first)
+{
+    OpenFileId fid = Open(FILE_NAME);
+    if (fid < 0) {
+        return false;
+    }
+    int read = Read(buffer, SIZE, fid);
+    Close(fid);
+    if (read != SIZE) {
+        return false;
+    }
+    for (unsigned i = 0; i < SIZE; i++) {
+        if (buffer[i] != Expected(i, first)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int
+Fail(const char *why)
+{
+    Nputs("mmaptest: ");
+    Nputs(why);
+    Nputs("\n");
+    return 1;
+}
+
+int
+main(void)
+{
+    for (unsigned i = 0; i < SIZE; i++) {
+        buffer[i] = Expected(i, 'a');
+    }
+    Create(FILE_NAME);
+    OpenFileId fid = Open(FILE_NAME);
+    if (fid < 0) {
+        return Fail("no se pudo crear el archivo");
+    }
+    Write(buffer, SIZE, fid);
+
+    if (Mmap(fid, 0, -1) != 0) {
+        return Fail("se mapeo con un largo negativo");
+    }
+    char *map = Mmap(fid, 0, 0);
+    if (map == 0) {
+        return Fail("no se pudo mapear el archivo");
+    }
+    for (unsigned i = 0; i < SIZE; i++) {
+        if (map[i] != Expected(i, 'a')) {
+            return Fail("el mapeo no tiene el contenido del archivo");
+        }
+        map[i] = Expected(i, 'A');
+    }
+    if (Munmap(map) != 0 || Munmap(map) != -1) {
+        return Fail("Munmap no quita el mapeo una sola vez");
+    }
+    Close(fid);
+    if (!CheckFile('A')) {
+        return Fail("lo escrito no llego al archivo con Munmap");
+    }
+
+    // El hijo lo mapea, lo escribe y termina sin Munmap: se escribe al salir.
+    SpaceId child = Fork(true);
+    if (child < 0) {
+        return Fail("no se pudo crear el hijo");
+    }
+    if (child == 0) {
+        fid = Open(FILE_NAME);
+        map = fid < 0 ? 0 : Mmap(fid, 0, 0);
+        if (map == 0) {
+            Exit(1);
+        }
+        for (unsigned i = 0; i < SIZE; i++) {
+            map[i] = Expected(i, '0');
+        }
+        Exit(0);
+    }
+    if (Join(child) != 0) {
+        return Fail("el hijo no pudo mapear el archivo");
+    }
+    if (!CheckFile('0')) {
+        return Fail("lo escrito no llego al archivo con Exit");
+    }
+
+    Remove(FILE_NAME);
+    Nputs("mmaptest: ok\n");
+    return 0;
+}
@@ -11,6 +11,11 @@
 #include "lib/bitmap.hh"
 #include "mmu.hh" //NUM_PHYS_PAGES
 #include "vmem/coremap.hh"
+#ifdef SWAP
+#include "vmem/page_cache.hh"
+#include "vmem/swap_partition.hh"
+#include "threads/condition.hh"
+#endif
 
 #include <algorithm>
 #include <stdint.h>
@@ -21,24 +26,109 @@
 #define ADDR_IN_SWAP -2
 
 
+// Se crean en InitFrameTables, cuando ya se sabe cuantos marcos hay.
 #ifndef SWAP
-Bitmap *usedPages = new Bitmap(NUM_PHYS_PAGES);
+Bitmap *usedPages = nullptr;
 #else
-Coremap *coremap = new Coremap(NUM_PHYS_PAGES);
+Coremap *coremap = nullptr;
+PageCache *pageCache = nullptr;
+SwapPartition *swapPartition = nullptr;
 #endif
 Lock *usedPagesLock = new Lock("usedPagesLock");
 
 #ifdef SWAP
+// Imagen del disco de la particion de swap.
+static const char SWAP_NAME[] = "SWAP";
+
+unsigned faultAroundPages = 1;
+
 #ifdef PV_POLICY_FIFO
     #include "lib/list.hh"
     // queue, donde vamos agregando cuando se agrega una pagina a la ram su physicalPage.
     List<int*> *pvFIFO = new List <int*>;
 #endif
-#ifdef PV_POLICY_CLOCK
+#if defined(PV_POLICY_CLOCK) || defined(PV_POLICY_AGING)
     // valor de pagina fisica a checkear como victima. Se le hace %NUM_PHYS_PAGES para acotarlo.
     unsigned pvClock = 0;
 #endif
+
+// Daemon de paginacion. Cuando quedan menos de pageoutLow marcos libres desaloja victimas hasta tener pageoutHigh,
+// escribiendo antes las modificadas; asi un fallo de pagina casi siempre encuentra un marco libre y solo lee.
+static unsigned pageoutLow;
+static unsigned pageoutHigh;
+static Condition *pageoutWanted;  // Espera el daemon, hasta que falten marcos.
+static Condition *pageoutDone;    // Esperan los que necesitan un marco, o que termine de escribirse una pagina suya.
+static AddressSpace *pageoutCleaning = nullptr;  // Espacio de la pagina que el daemon esta escribiendo, si hay.
+static unsigned pageoutSwapFailures = 0;  // Veces que el daemon no pudo liberar un marco por falta de lugar en la SWAP.
+static bool skippedForSwap;               // Si PickVictim dejo algun marco por falta de lugar en la SWAP.
+
+// Paginas prometidas a los procesos, las del programa, el heap y el stack de cada uno, y cuantas se pueden
+// prometer: las que entran entre los marcos y la particion de swap. Asi lo que se dio siempre tiene donde estar.
+static unsigned committedPages = 0;
+static unsigned commitLimit;
+static void PageoutDaemon(void *);
+
+// Daemon de ceros. Mantiene zeroPoolSize marcos libres ya llenos de ceros, para cargar las paginas PAGE_ZERO sin
+// tocarlas. Solo trabaja cuando un procesador se quedaria sin nada que correr, por ejemplo mientras todos esperan
+// al disco: lo despierta el scheduler (ZeroWhenIdle) en vez de entrar en Idle.
+static unsigned zeroPoolSize;
+static Semaphore *zeroIdle;         // Espera el daemon, hasta que haya tiempo libre.
+static bool zeroerWaiting = false;  // Si esta esperando en zeroIdle.
+static void ZeroDaemon(void *);
+static bool ZeroWhenIdle();
+#ifdef USE_TLB
+static void ShootdownTLB(AddressSpace *space, unsigned vpn);
+static void SyncAllTlbs();
+#endif
+
+// Nombre de la politica de reemplazo, para las estadisticas.
+#if defined(PV_POLICY_FIFO)
+static const char PV_POLICY_NAME[] = "fifo";
+#elif defined(PV_POLICY_CLOCK)
+static const char PV_POLICY_NAME[] = "clock";
+#elif defined(PV_POLICY_AGING)
+static const char PV_POLICY_NAME[] = "aging";
+#else
+static const char PV_POLICY_NAME[] = "random";
+#endif
+#endif
+
+#ifdef USE_TLB
+// Identificadores de espacio de direcciones (ASID) de las entradas de la TLB. Se reparten en orden, y cuando se
+// acaban empieza una nueva generacion: se vacian todas las TLB y cada espacio pide uno nuevo la proxima vez que corre.
+static unsigned asidGeneration = 1;
+static unsigned nextAsid = 0;
+static AddressSpace *asidOwners[NUM_ASIDS];  // Espacio de cada ASID de la generacion actual, nullptr si termino.
+#endif
+
+void
+InitFrameTables()
+{
+#ifndef SWAP
+    ASSERT(usedPages == nullptr);
+    usedPages = new Bitmap(NUM_PHYS_PAGES);
+#else
+    ASSERT(coremap == nullptr);
+    coremap = new Coremap(NUM_PHYS_PAGES);
+    pageCache = new PageCache(NUM_PHYS_PAGES);
+    swapPartition = new SwapPartition(SWAP_NAME);
+    commitLimit = NUM_PHYS_PAGES + swapPartition->CountFree();
+    stats->pagePolicy = PV_POLICY_NAME;
+
+    pageoutLow = DivRoundUp(NUM_PHYS_PAGES, 16U);
+    pageoutHigh = std::min(2 * pageoutLow, NUM_PHYS_PAGES);
+    pageoutWanted = new Condition("pageoutWanted", usedPagesLock);
+    pageoutDone = new Condition("pageoutDone", usedPagesLock);
+    Thread *daemon = new Thread("pageout", false, 0);
+    daemon->Fork(PageoutDaemon, nullptr);
+
+    zeroPoolSize = pageoutLow;
+    zeroIdle = new Semaphore("zeroIdle", 0);
+    Thread *zeroer = new Thread("zeroer", false, MAX_PRIORITY);
+    zeroer->Fork(ZeroDaemon, nullptr);
+    scheduler->SetIdleWork(ZeroWhenIdle);
 #endif
+}
 
 // No se pueden realizar las llamas a estas funciones ya que por lo aparente, la MMU traduce tambien estas llamadas.
 // Y los calculos de offsets se traducen de manera incorrecta.
@@ -58,23 +148,38 @@ const uint32_t dataOffset(const uint32_t dataSize, const uint32_t dataAddrStart,
     return data_offset;
 }
 
-AddressSpace::AddressSpace(OpenFile *_executable_file, int pid)
+AddressSpace::AddressSpace(OpenFile *_executable_file, int pid,
+                           const char *name)
 {
     ASSERT(_executable_file != nullptr);
+    ASSERT(name != nullptr);
     threadPid = pid;
+    strncpy(executableName, name, FILE_NAME_MAX_LEN);
+    executableName[FILE_NAME_MAX_LEN] = '\0';
+    profile = profiler != nullptr ? profiler->GetProfile(name) : nullptr;
+#ifdef USE_TLB
+    asid = 0;
+    asidOwnerGeneration = 0;  // Ninguna: se le da un ASID la primera vez que corre.
+#endif
     executable_file = _executable_file;
     exe = new Executable(_executable_file);
     
-    // How big is address space?
-    size = exe->GetSize() + USER_STACK_SIZE;
-    // We need to increase the size to leave room for the stack.
-    numPages = DivRoundUp(size, PAGE_SIZE);
-    pageTable = new TranslationEntry[numPages]; // Movimos esto aca porque la seguridad de fullMemory causaba problemas de seguridad al acceder a espacio no existente
+    // How big is address space?  El programa va al principio, seguido del heap, y el stack al final; en el medio
+    // se mapean archivos. Las paginas que no son de nadie no tienen entrada en la tabla, no ocupan memoria.
+    imagePages = DivRoundUp(exe->GetSize(), PAGE_SIZE);
+    heapPages = 0;
+    stackPages = DivRoundUp(USER_STACK_SIZE, PAGE_SIZE);
+    numPages = std::max(USER_ADDRESS_SPACE_SIZE / PAGE_SIZE, imagePages + stackPages);
+    pageTable = new PageTable(numPages); // Movimos esto aca porque la seguridad de fullMemory causaba problemas de seguridad al acceder a espacio no existente
+#ifdef SWAP
+    mappings = nullptr;
+    committed = 0;
+#endif
 
     fullMemory = false; // Al empezar el programa asumimos que hay memoria fisica disponible. Esto se comprueba mas adelante.
-    DEBUG('p', "Initializing address space, num pages %u, size %u\n", numPages, size);
-
     size = numPages * PAGE_SIZE;
+    DEBUG('p', "Initializing address space, num pages %u (program %u, stack %u), size %u\n",
+          numPages, imagePages, stackPages, size);
 
     codeSize = exe->GetCodeSize();
     codeAddrStart = exe->GetCodeAddr();
@@ -83,14 +188,27 @@ AddressSpace::AddressSpace(OpenFile *_executable_file, int pid)
     initDataSize = exe->GetInitDataSize();
     initDataAddrStart = exe->GetInitDataAddr();
     initDataAddrEnd = initDataAddrStart + initDataSize - 1;
+
+#ifdef SWAP
+    usedPagesLock->Acquire();
+    if (!CommitPages(imagePages + stackPages)) {
+        DEBUG('p', "Not enough memory nor swap for the program, finishing process\n");
+        numPages = 0;
+        fullMemory = true;
+        usedPagesLock->Release();
+        return;
+    }
+    usedPagesLock->Release();
+#endif
+
 // Si no esta definida SWAP, podemos controlar antes si el programa puede ser cargado.
 
 #ifndef DEMAND_LOADING
 
     usedPagesLock->Acquire();
-    if (numPages > usedPages->CountClear()) {
+    if (imagePages + stackPages > usedPages->CountClear()) {
 
-        DEBUG('p', "numpages: %d, used: %d\n", numPages, usedPages->CountClear());
+        DEBUG('p', "numpages: %d, used: %d\n", imagePages + stackPages, usedPages->CountClear());
         DEBUG('p', "Memory full, finishing process\n");
         numPages = 0;
         fullMemory = true;
@@ -100,8 +218,10 @@ AddressSpace::AddressSpace(OpenFile *_executable_file, int pid)
     usedPagesLock->Release();
     // En el caso en el que este desactivada la carga por 
     // demanda se cargan todas las paginas a memoria al principio.
-    for (unsigned i = 0; i < numPages; i++) {
-        pageTable[i].physicalPage = -1;
+    for (unsigned i = 0; i < imagePages; i++) {
+        LoadPage(i);
+    }
+    for (unsigned i = numPages - stackPages; i < numPages; i++) {
         LoadPage(i);
     }
     DEBUG('a', "Initialized user address space\n");
@@ -111,31 +231,180 @@ AddressSpace::AddressSpace(OpenFile *_executable_file, int pid)
     }
 #else
 #ifdef SWAP
-    char fileName[5 + 5];
-    snprintf(fileName, sizeof(fileName), "SWAP.%d", threadPid);
-    DEBUG('p', "Valor filename SWAP en creacion de archivo: %s\n", fileName);
-    ASSERT(fileSystem->Create(fileName, size));
-    file_swap = fileSystem->Open(fileName);
+    executableSector  = _executable_file->GetSector();
+    executableVersion = _executable_file->GetVersion();
+#endif
+    // Las paginas no tienen entrada en la tabla hasta que se cargan por primera vez: las que no tienen entrada
+    // estan como al principio, en el ejecutable o en cero. Los lugares en la particion de swap se toman recien
+    // cuando se desaloja cada pagina.
+#endif
+}
+
+AddressSpace::AddressSpace(AddressSpace *parent, OpenFile *_executable_file,
+                           int pid)
+{
+    ASSERT(parent != nullptr);
+    ASSERT(_executable_file != nullptr);
+    threadPid = pid;
+    strcpy(executableName, parent->executableName);
+    profile = parent->profile;
+#ifdef USE_TLB
+    asid = 0;
+    asidOwnerGeneration = 0;
+#endif
+    executable_file = _executable_file;
+    exe = new Executable(_executable_file);
+
+    numPages = parent->numPages;
+    imagePages = parent->imagePages;
+    heapPages = parent->heapPages;
+    stackPages = parent->stackPages;
+    size = parent->size;
+    codeSize = parent->codeSize;
+    codeAddrStart = parent->codeAddrStart;
+    codeAddrEnd = parent->codeAddrEnd;
+    initDataSize = parent->initDataSize;
+    initDataAddrStart = parent->initDataAddrStart;
+    initDataAddrEnd = parent->initDataAddrEnd;
+    pageTable = new PageTable(numPages);
+    fullMemory = false;
+    DEBUG('p', "Forking address space of %s, num pages %u\n", executableName, numPages);
+
+#ifndef SWAP
+    // Sin SWAP no se pueden pedir marcos despues: se copian ahora todas las paginas cargadas, o no se crea.
+    usedPagesLock->Acquire();
+    unsigned loaded = 0;
+    for (PageTableEntry *entry = parent->pageTable->First(); entry != nullptr;
+         entry = parent->pageTable->Next(entry)) {
+        if (entry->translation.physicalPage != NOT_LOAD_ADDR) {
+            loaded++;
+        }
+    }
+    if (loaded > usedPages->CountClear()) {
+        DEBUG('p', "Memory full, cannot fork\n");
+        numPages = 0;
+        fullMemory = true;
+        usedPagesLock->Release();
+        return;
+    }
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    for (PageTableEntry *entry = parent->pageTable->First(); entry != nullptr;
+         entry = parent->pageTable->Next(entry)) {
+        int from = entry->translation.physicalPage;
+        if (from != NOT_LOAD_ADDR) {
+            TranslationEntry *page = &pageTable->Enter(entry->translation.virtualPage)->translation;
+            *page = entry->translation;
+            int to = usedPages->Find();
+            memcpy(&mainMemory[to * PAGE_SIZE], &mainMemory[from * PAGE_SIZE], PAGE_SIZE);
+            machine->GetMMU()->InvalidateDecodedFrame(to);
+            page->physicalPage = to;
+        }
+    }
+    usedPagesLock->Release();
+#else
+    executableSector  = parent->executableSector;
+    executableVersion = parent->executableVersion;
+    mappings = nullptr;
+    committed = 0;
+
+    usedPagesLock->Acquire();
+    if (!CommitPages(imagePages + heapPages + stackPages)) {
+        DEBUG('p', "Not enough memory nor swap, cannot fork\n");
+        numPages = 0;
+        fullMemory = true;
+        usedPagesLock->Release();
+        return;
+    }
+#ifdef USE_TLB
+    // Los bits de modificacion del padre tienen que estar al dia: dicen que paginas solo estan en memoria.
+    SyncAllTlbs();
+#endif
+    // Las paginas del padre que estan en SWAP se copian a lugares propios del hijo; si no entran, no se crea.
+    unsigned swapped = 0;
+    for (PageTableEntry *entry = parent->pageTable->First(); entry != nullptr;
+         entry = parent->pageTable->Next(entry)) {
+        if (entry->translation.physicalPage == ADDR_IN_SWAP) {
+            swapped++;
+        }
+    }
+    if (swapped > swapPartition->CountFree()) {
+        DEBUG('p', "Swap partition full, cannot fork\n");
+        numPages = 0;
+        fullMemory = true;
+        usedPagesLock->Release();
+        return;
+    }
+    for (PageTableEntry *entry = parent->pageTable->First(); entry != nullptr;
+         entry = parent->pageTable->Next(entry)) {
+        // Las paginas que el padre no cargo tampoco tienen entrada en el hijo, ni las de sus archivos mapeados.
+        int physical = entry->translation.physicalPage;
+        unsigned vpn = entry->translation.virtualPage;
+        if (physical == NOT_LOAD_ADDR || parent->FindMapping(vpn) != nullptr) {
+            continue;
+        }
+        PageTableEntry *child = pageTable->Enter(vpn);
+        child->translation = entry->translation;
+        if (physical == ADDR_IN_SWAP) {
+            // Se copia abajo a un lugar propio de la SWAP: el padre puede volver a escribir el suyo.
+            child->swapSlot = swapPartition->AllocateSlot();
+            ASSERT(child->swapSlot != -1);  // Se conto arriba que hay lugar.
+            continue;
+        }
 
+        // Las paginas en memoria se comparten de solo lectura hasta que alguno las escriba. El hijo no tiene
+        // ninguna otra copia de las que el padre modifico o tiene en su SWAP.
+        coremap->Share(physical, this);
+        child->translation.dirty = entry->translation.dirty || entry->swapSlot != -1;
+        if (!entry->translation.readOnly) {
+            entry->translation.readOnly = true;
+            entry->copyOnWrite = true;
+        }
+        child->translation.readOnly = true;
+        child->copyOnWrite = entry->copyOnWrite;
+#ifdef USE_TLB
+        // Las entradas del padre en las TLB todavia le permiten escribirla.
+        ShootdownTLB(parent, vpn);
 #endif
-    // Se inicializan las paginas con una direccion fisica invalidad para poder 
-    // distingir entre las que estan cargadas y las que no.
-    for (unsigned i = 0; i < numPages; i++) {
-        pageTable[i].virtualPage  = i;
-        pageTable[i].physicalPage = NOT_LOAD_ADDR;
-        pageTable[i].valid        = true;
+        stats->numPagesShared++;
+    }
+    usedPagesLock->Release();
+    machine->GetMMU()->InvalidateTranslationCache();
+
+    // El padre esta haciendo el Fork, asi que nadie trae a memoria ni cambia sus paginas en SWAP mientras se copian.
+    char *page = new char [PAGE_SIZE];
+    for (PageTableEntry *entry = pageTable->First(); entry != nullptr; entry = pageTable->Next(entry)) {
+        if (entry->translation.physicalPage == ADDR_IN_SWAP) {
+            swapPartition->ReadPage(parent->pageTable->Find(entry->translation.virtualPage)->swapSlot, page);
+            swapPartition->WritePage(entry->swapSlot, page);
+            stats->numSwapReads++;
+            stats->numSwapWrites++;
+        }
     }
+    delete [] page;
 #endif
 }
 
 AddressSpace::~AddressSpace()
 {
+#ifdef SWAP
+    // Lo modificado en los archivos mapeados se escribe antes de soltar sus marcos.
+    while (mappings != nullptr) {
+        Unmap(mappings->firstVpn);
+    }
+#endif
     // Liberamos los marcos utilizados por el proceso
     usedPagesLock->Acquire();
+#ifdef SWAP
+    // Si el daemon esta escribiendo una pagina nuestra, el marco y el lugar en la SWAP tienen que seguir siendo nuestros.
+    while (pageoutCleaning == this) {
+        pageoutDone->Wait();
+    }
+#endif
 #ifndef SWAP
-    for(unsigned p = 0;  p< numPages; p++) {
-        if (pageTable[p].physicalPage != NOT_LOAD_ADDR && pageTable[p].physicalPage != ADDR_IN_SWAP) {
-            usedPages->Clear(pageTable[p].physicalPage);
+    for (PageTableEntry *entry = pageTable->First(); entry != nullptr; entry = pageTable->Next(entry)) {
+        int physical = entry->translation.physicalPage;
+        if (physical != NOT_LOAD_ADDR && physical != ADDR_IN_SWAP) {
+            usedPages->Clear(physical);
         }
     }
     DEBUG('p', "Deleted page table\n");
@@ -144,31 +413,34 @@ AddressSpace::~AddressSpace()
     }
 #else
 // Cambiar la funcion de carga en memoria para chekear si la entrada a esa pagina fisica esta en nullptr. Esto significa que nadie cargo esa pagina todavia.
-    for(unsigned p = 0; p < numPages; p++) {
-        if(pageTable[p].physicalPage != NOT_LOAD_ADDR && pageTable[p].physicalPage != ADDR_IN_SWAP && threadPid == coremap->addressInfo[pageTable[p].physicalPage].thread->space->threadPid) {
-            coremap->Clear(pageTable[p].physicalPage);
-            coremap->addressInfo[pageTable[p].physicalPage].thread = nullptr;
-            coremap->addressInfo[pageTable[p].physicalPage].loading = false;
+    for (PageTableEntry *entry = pageTable->First(); entry != nullptr; entry = pageTable->Next(entry)) {
+        // Los marcos compartidos despues de un Fork se liberan cuando se va el ultimo que los usa; los del cache
+        // de paginas quedan en memoria para el proximo que corra el programa.
+        int physical = entry->translation.physicalPage;
+        if (physical != NOT_LOAD_ADDR && physical != ADDR_IN_SWAP) {
+            coremap->Unshare(physical, this);
+        }
+        if (entry->swapSlot != -1) {
+            swapPartition->FreeSlot(entry->swapSlot);
         }
     }
+    committedPages -= committed;
     if (debug.IsEnabled('p')) {
         coremap->Print();
     }
 #endif
     usedPagesLock->Release();
+#ifdef USE_TLB
+    // Sus entradas pueden seguir en las TLB, pero el ASID no se vuelve a repartir hasta la proxima generacion.
+    if (asidOwnerGeneration == asidGeneration) {
+        asidOwners[asid] = nullptr;
+    }
+#endif
     
-    delete [] pageTable;
+    delete pageTable;
 
     // Se elimina el archivo lo descomente
     delete executable_file;
-    
-#ifdef SWAP
-    char fileName[5 + 5];
-    snprintf(fileName, sizeof(fileName), "SWAP.%d", threadPid);
-    DEBUG('p', "Valor filename SWAP en destruccion de archivo: %s\n", fileName);
-    delete file_swap;
-    fileSystem->Remove(fileName);
-#endif
 
 
     DEBUG('a', "Deleted user address space\n");
@@ -189,265 +461,1449 @@ AddressSpace::~AddressSpace()
 void
 AddressSpace::LoadPageFromCode(int vpn, int physical)
 {
-    const uint32_t pageAddrStart = vpn * PAGE_SIZE;
-    const uint32_t pageAddrEnd = pageAddrStart + PAGE_SIZE - 1;
+    LoadPagesFromCode(vpn, 1, &physical);
+}
+
+void
+AddressSpace::LoadPagesFromCode(unsigned firstVpn, unsigned count,
+                                const int *frames)
+{
+    const uint32_t runAddrStart = firstVpn * PAGE_SIZE;
+    const uint32_t runAddrEnd = runAddrStart + count * PAGE_SIZE - 1;
 
     char *mainMemory = machine->GetMMU()->mainMemory;
 
-    pageTable[vpn].virtualPage  = vpn;
-    pageTable[vpn].physicalPage = physical;
-    pageTable[vpn].valid        = true;
-    pageTable[vpn].readOnly     = codeSize > 0 && pageAddrStart <= codeAddrEnd && pageAddrEnd >= codeAddrStart && !(codeAddrEnd < pageAddrEnd);
-    //pageTable[vpn].use          = false;
-    //pageTable[vpn].dirty        = false;
+    // Una sola pagina se lee directo a su marco; varias se leen juntas a un buffer y despues se reparten.
+    char *run = count == 1 ? &mainMemory[frames[0] * PAGE_SIZE] : new char [count * PAGE_SIZE];
+    DEBUG('p', "Zeroing out virtual pages %u to %u\n", firstVpn, firstVpn + count - 1);
+    memset(run, 0, count * PAGE_SIZE);
+
+    if (codeSize > 0 && runAddrStart <= codeAddrEnd && runAddrEnd >= codeAddrStart) {
+        const uint32_t code_bytes = std::min(codeAddrEnd, runAddrEnd) - std::max(codeAddrStart, runAddrStart) + 1;
+
+        const uint32_t memory_offset = (codeAddrStart > runAddrStart) ? (codeAddrStart - runAddrStart) : 0;
+
+        const uint32_t code_offset = (memory_offset != 0) ? 0 : (runAddrStart - codeAddrStart);
 
-    mainMemory = machine->GetMMU()->mainMemory;
-    DEBUG('p', "Zeroing out virtual page %u, physical page: %u\n", vpn, physical);
-    memset(&mainMemory[physical * PAGE_SIZE], 0, PAGE_SIZE);
+        DEBUG('p', "Copying code block from 0x%X to 0x%X (%u bytes)\n",
+            code_offset, code_offset + code_bytes - 1, code_bytes);
+        exe->ReadCodeBlock(&run[memory_offset], code_bytes, code_offset);
+    }
 
-    if (codeSize > 0 && pageAddrStart <= codeAddrEnd && pageAddrEnd >= codeAddrStart) {
-        const uint32_t code_bytes = std::min(codeAddrEnd, pageAddrEnd) - std::max(codeAddrStart, pageAddrStart) + 1;
+    if (initDataSize > 0 && runAddrStart <= initDataAddrEnd && runAddrEnd >= initDataAddrStart) {
+        const uint32_t data_bytes = std::min(initDataAddrEnd, runAddrEnd) - std::max(initDataAddrStart, runAddrStart) + 1;
 
-        const uint32_t memory_offset = (codeAddrStart > pageAddrStart) ? (codeAddrStart - pageAddrStart) : 0;
+        const uint32_t memory_offset = (initDataAddrStart > runAddrStart) ? (initDataAddrStart - runAddrStart) : 0;
 
-        const uint32_t code_offset = (memory_offset != 0) ? 0 : (pageAddrStart - codeAddrStart);
+        const uint32_t data_offset = (memory_offset != 0) ? 0 : (runAddrStart - initDataAddrStart);
 
-        DEBUG('p', "Copying code block from 0x%X to 0x%X (%u bytes) into physical page %u\n",
-            code_offset, code_offset + code_bytes - 1, code_bytes, physical);
-        exe->ReadCodeBlock(&mainMemory[physical * PAGE_SIZE + memory_offset], code_bytes, code_offset);
+        DEBUG('p', "Copying data block from 0x%X to 0x%X (%u bytes)\n",
+            data_offset, data_offset + data_bytes - 1, data_bytes);
+        exe->ReadDataBlock(&run[memory_offset], data_bytes, data_offset);
     }
-    
-    /*
-    if (codeSize > 0 && pageAddrStart <= codeAddrEnd && pageAddrEnd >= codeAddrStart) {
-        const uint32_t data_bytes = dataBytes(codeAddrStart, codeAddrEnd, pageAddrStart, pageAddrEnd);
-        const uint32_t memory_offset = memoryOffset(codeAddrStart, pageAddrStart);
-        const uint32_t data_offset = dataOffset(codeSize, codeAddrStart, pageAddrStart);
-        DEBUG('e', "Values dt.data_bytes = %u, dt.memory_offset = %u, dt.data_offset = %u\n", data_bytes, memory_offset, data_offset);
-        DEBUG('p', "Copying code block from 0x%X to 0x%X (%u bytes) into physical page %u\n",
-        exe.ReadCodeBlock(&mainMemory[physical * PAGE_SIZE + memory_offset], data_bytes, data_offset);
-    */
-    if (initDataSize > 0 && pageAddrStart <= initDataAddrEnd && pageAddrEnd >= initDataAddrStart) {
-        DEBUG('p', "Entro al segundo if\n");
-        const uint32_t data_bytes = std::min(initDataAddrEnd, pageAddrEnd) - std::max(initDataAddrStart, pageAddrStart) + 1;
-
-        const uint32_t memory_offset = (initDataAddrStart > pageAddrStart) ? (initDataAddrStart - pageAddrStart) : 0;
-
-        const uint32_t data_offset = (memory_offset != 0) ? 0 : (pageAddrStart - initDataAddrStart);
-        
-        exe->ReadDataBlock(&mainMemory[physical * PAGE_SIZE + memory_offset], data_bytes, data_offset);
-        DEBUG('p', "Termino el segundo if\n");
-    }
-    /*
-    if (initDataSize > 0 && pageAddrStart <= initDataAddrEnd && pageAddrEnd >= initDataAddrStart) {
-        const uint32_t data_bytes = dataBytes(initDataAddrStart, initDataAddrEnd, pageAddrStart, pageAddrEnd);
-        const uint32_t memory_offset = memoryOffset(initDataAddrStart, pageAddrStart);
-        const uint32_t data_offset = dataOffset(codeSize, initDataAddrStart, pageAddrStart);
-        DEBUG('e', "Values dt.data_bytes = %u, dt.memory_offset = %u, dt.data_offset = %u\n", data_bytes, memory_offset, data_offset);
-        DEBUG('p', "Copying code block from 0x%X to 0x%X (%u bytes) into physical page %u\n",
-            data_offset, data_offset + data_bytes - 1, data_bytes, physical);
-        exe.ReadCodeBlock(&mainMemory[physical * PAGE_SIZE + memory_offset], data_bytes, data_offset);
-    */
-}
 
+    for (unsigned i = 0; i < count; i++) {
+        const unsigned vpn = firstVpn + i;
+        if (count > 1) {
+            memcpy(&mainMemory[frames[i] * PAGE_SIZE], &run[i * PAGE_SIZE], PAGE_SIZE);
+        }
+        TranslationEntry *page = &pageTable->Enter(vpn)->translation;
+        page->virtualPage  = vpn;
+        page->physicalPage = frames[i];
+        page->valid        = true;
+        page->readOnly     = IsTextPage(vpn);
+    }
+    if (count > 1) {
+        delete [] run;
+    }
+}
 
-#ifdef SWAP
-int
-AddressSpace::PickVictim()
+PageKind
+AddressSpace::KindOf(unsigned vpn) const
 {
-#ifdef PV_POLICY_FIFO
-    return *(pvFIFO->Pop());
-#else
-    #ifdef PV_POLICY_CLOCK
-    int i = 0;
-    while (i < 2) {
-        // En la primera pasada, checkeamos por use = false y dirty = false
-        int paginasVisitadas = 0;
-        while (paginasVisitadas < NUM_PHYS_PAGES) {
-            if (!coremap->addressInfo[pvClock].thread->space->pageTable[coremap->addressInfo[pvClock].vpn].use && !coremap->addressInfo[pvClock].thread->space->pageTable[coremap->addressInfo[pvClock].vpn].dirty) {
-                return pvClock;
-            }
-            pvClock = (pvClock + 1) % NUM_PHYS_PAGES;
-            paginasVisitadas++;
-        }
-        // En la segunda pasada, checkeamos por use = false y dirty = true. Si no lo cumple, seteamos use = false 
-        paginasVisitadas = 0;
-        while (paginasVisitadas < NUM_PHYS_PAGES) {
-            if (!coremap->addressInfo[pvClock].thread->space->pageTable[coremap->addressInfo[pvClock].vpn].use && coremap->addressInfo[pvClock].thread->space->pageTable[coremap->addressInfo[pvClock].vpn].dirty) {
-                return pvClock;
-            }
-            coremap->addressInfo[pvClock].thread->space->pageTable[coremap->addressInfo[pvClock].vpn].use = false;
-            pvClock = (pvClock + 1) % NUM_PHYS_PAGES;
-            paginasVisitadas++;
-        }
-        i++;
-        // Repetimos la primera y segunda pasada, pero ahora estamos seguros que use = false, por lo que se encontrara una pagina.
+#ifdef SWAP
+    if (FindMapping(vpn) != nullptr) {
+        return PAGE_MAPPED;
     }
-    #else
-    return std::rand() % NUM_PHYS_PAGES;
-    #endif
 #endif
+    const uint32_t pageAddrStart = vpn * PAGE_SIZE;
+    const uint32_t pageAddrEnd = pageAddrStart + PAGE_SIZE - 1;
+    const bool code = codeSize > 0 && pageAddrStart <= codeAddrEnd && pageAddrEnd >= codeAddrStart;
+    const bool data = initDataSize > 0 && pageAddrStart <= initDataAddrEnd && pageAddrEnd >= initDataAddrStart;
+    if (code && !(codeAddrEnd < pageAddrEnd)) {
+        return PAGE_TEXT;
+    } else if (code || data) {
+        return PAGE_FILE;
+    } else {
+        return PAGE_ZERO;
+    }
 }
 
 bool
-AddressSpace::StorePageInSWAP(int vpn)
+AddressSpace::IsTextPage(unsigned vpn) const
 {
-    int physical = pageTable[vpn].physicalPage;
-    char* addrMemStart = &machine->GetMMU()->mainMemory[physical * PAGE_SIZE];
-    bool correct = (file_swap->WriteAt(addrMemStart, PAGE_SIZE, vpn * PAGE_SIZE) == PAGE_SIZE);
-
-    pageTable[vpn].physicalPage = ADDR_IN_SWAP;
-
-    return correct;
-
+    return KindOf(vpn) == PAGE_TEXT;
 }
 
-
 bool
-AddressSpace::LoadPageFromSWAP(int vpn, int physical){
-    char* addrMemStart = &machine->GetMMU()->mainMemory[physical * PAGE_SIZE];
-    bool correct = (file_swap->ReadAt(addrMemStart, PAGE_SIZE, vpn * PAGE_SIZE) == PAGE_SIZE);
-
-    pageTable[vpn].virtualPage  = vpn;
-    pageTable[vpn].physicalPage = physical;
-    //pageTable[vpn].use          = false;
-    //pageTable[vpn].dirty        = false;
-
-    return correct;
-}
+AddressSpace::IsValidPage(unsigned vpn) const
+{
+    if (vpn < imagePages + heapPages || (vpn >= numPages - stackPages && vpn < numPages)) {
+        return true;
+    }
+#ifdef SWAP
+    return FindMapping(vpn) != nullptr;
+#else
+    return false;
 #endif
+}
 
-void
-AddressSpace::LoadPage(int vpn) {
-// Si SWAP no esta activada ------------------------------------------------------------------
-    pageTable[vpn].use          = true;
-    pageTable[vpn].dirty        = true;
-#ifndef SWAP
+int
+AddressSpace::GrowHeap(unsigned count)
+{
+    // Puede crecer hasta el archivo mapeado mas bajo, o hasta el stack.
     usedPagesLock->Acquire();
-    if (usedPages->CountClear() == 0) {
-        DEBUG('p', "Memoria llena, no se puede cargar la pagina.\n");
-        fullMemory = true;
+    const unsigned first = imagePages + heapPages;
+    unsigned limit = numPages - stackPages;
+#ifdef SWAP
+    for (const Mapping *mapping = mappings; mapping != nullptr; mapping = mapping->next) {
+        limit = mapping->firstVpn;
+    }
+#endif
+    if (limit - first < count) {
         usedPagesLock->Release();
-        return;
-        // El programa no puede continuar ejecutandose.
+        DEBUG('p', "No hay lugar para agrandar el heap %u paginas\n", count);
+        return -1;
     }
-    
-    DEBUG('p', "used: %d\n", usedPages->CountClear());
-    const int physical = usedPages->Find();
-    usedPagesLock->Release();
-#else
-// Si SWAP esta activada ---------------------------------------------------------------------
-    DEBUG('p', "LoadPage\n");
-    usedPagesLock->Acquire();
-    int physical = coremap->Find(vpn);
-    // Si es distinto de -1, entonces todavia hay lugar. No hacer pickvictim
-    // Sino, no hay lugar para cargar la pagina en memoria. Se tiene que reemplazar una pagina actual.
-
-    while (physical == -1) {
-        DEBUG('p', "Entre a pick Victim\n");
-        int pv = PickVictim();
-        if (!coremap->addressInfo[pv].loading){
-            DEBUG('p', "Pagina fisica a reemplazar: %d\n",pv);
-            DEBUG('p', "Pid del thread victima: %d\n",coremap->addressInfo[pv].thread->space->threadPid);
-            physical = pv;
-        }
+#ifdef SWAP
+    if (!CommitPages(count)) {
+        usedPagesLock->Release();
+        DEBUG('p', "No hay memoria ni SWAP para agrandar el heap %u paginas\n", count);
+        return -1;
     }
-#ifdef PV_POLICY_FIFO
-    int *a = (int*)malloc(sizeof(int));
-    *a = physical;
-    pvFIFO->Append(a);
 #endif
-    coremap->addressInfo[physical].loading = true;
-    AddressInfoEntry victim = coremap->addressInfo[physical];
-    usedPagesLock->Release();
-    // Si la victima es una pagina nuestra y ademas esta en la tlb hay que invalidar la entrada.
-    for(unsigned int i=0; i<TLB_SIZE; i++) {
-        if (machine->GetMMU()->tlb[i].virtualPage == victim.vpn) {
-            machine->GetMMU()->tlb[i].valid = false;
-            break;
-        }
-    }
-    // Estimamos que nunca falle, si lo el sistema swap esta corrupto
-
-    if (victim.thread != nullptr){
-        ASSERT(victim.thread->space->StorePageInSWAP(victim.vpn));  // Si el ASSERT va a ser eliminado, checkear la llamada porque pageTable queda incorrecta
+#ifndef DEMAND_LOADING
+    // Sin carga por demanda se cargan ahora, como las del programa al crear el espacio.
+    if (count > usedPages->CountClear()) {
+        usedPagesLock->Release();
+        DEBUG('p', "Memoria llena, no se puede agrandar el heap\n");
+        return -1;
     }
-    coremap->addressInfo[physical].vpn = vpn;
-    coremap->addressInfo[physical].thread = currentThread;
 #endif
-    // Ahora tenemos una pagina disponible en memoria. Hay que ver de donde se carga la información.
-    if (pageTable[vpn].physicalPage == NOT_LOAD_ADDR) {
-        // Nunca se cargo, (LoadFromCode)
-        DEBUG('p', "Leyendo de archivo");
-        LoadPageFromCode(vpn, physical);
+    heapPages += count;
+    usedPagesLock->Release();
+
+#ifndef DEMAND_LOADING
+    for (unsigned vpn = first; vpn < first + count; vpn++) {
+        LoadPage(vpn);
     }
-#ifdef SWAP
-    if (pageTable[vpn].physicalPage == ADDR_IN_SWAP) {
-        DEBUG('p', "Leyendo de SWAP");
-        ASSERT(LoadPageFromSWAP(vpn, physical)); // Si el ASSERT va a ser eliminado, checkear la llamada porque pageTable queda incorrecta
+    if (fullMemory) {
+        // Otro proceso tomo los marcos mientras tanto: se deshace todo.
+        usedPagesLock->Acquire();
+        for (unsigned vpn = first; vpn < first + count; vpn++) {
+            const PageTableEntry *entry = pageTable->Find(vpn);
+            if (entry != nullptr && entry->translation.physicalPage != NOT_LOAD_ADDR) {
+                usedPages->Clear(entry->translation.physicalPage);
+            }
+            pageTable->Remove(vpn);
+        }
+        heapPages -= count;
+        fullMemory = false;
+        usedPagesLock->Release();
+        return -1;
     }
-
-    usedPagesLock->Acquire();
-    coremap->addressInfo[physical].loading = false;
-    usedPagesLock->Release();
 #endif
-    return;
+    DEBUG('p', "Heap agrandado hasta la pagina %u\n", first + count - 1);
+    return first;
 }
 
-/// Set the initial values for the user-level register set.
-///
-/// We write these directly into the â€œmachineâ€ registers, so that we can
-/// immediately jump to user code.  Note that these will be saved/restored
-/// into the `currentThread->userRegisters` when this thread is context
-/// switched out.
 void
-AddressSpace::InitRegisters()
+AddressSpace::ZeroFillPage(unsigned vpn, int physical, bool zeroed)
 {
-    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
-        machine->WriteRegister(i, 0);
+    if (zeroed) {
+        stats->numZeroPoolHits++;
+    } else {
+        DEBUG('p', "Zeroing out virtual page %u\n", vpn);
+        memset(&machine->GetMMU()->mainMemory[physical * PAGE_SIZE], 0, PAGE_SIZE);
     }
+    TranslationEntry *page = &pageTable->Enter(vpn)->translation;
+    page->virtualPage  = vpn;
+    page->physicalPage = physical;
+    page->valid        = true;
+    page->readOnly     = false;
+    stats->numZeroFillPages++;
+}
 
-    // Initial program counter -- must be location of `Start`.
-    machine->WriteRegister(PC_REG, 0);
 
-    // Need to also tell MIPS where next instruction is, because of branch
-    // delay possibility.
-    machine->WriteRegister(NEXT_PC_REG, 4);
+#ifdef USE_TLB
+void
+SyncTlbBits(const TranslationEntry *tlb)
+{
+    ASSERT(tlb != nullptr);
 
-    // Set the stack register to the end of the address space, where we
-    // allocated the stack; but subtract off a bit, to make sure we do not
-    // accidentally reference off the end!
-    machine->WriteRegister(STACK_REG, numPages * PAGE_SIZE - 16);
-    DEBUG('a', "Initializing stack register to %u\n",
-          numPages * PAGE_SIZE - 16);
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        if (tlb[i].valid && asidOwners[tlb[i].asid] != nullptr) {
+            asidOwners[tlb[i].asid]->SyncTlbEntry(&tlb[i]);
+        }
+    }
 }
 
-/// On a context switch, save any machine state, specific to this address
-/// space, that needs saving.
-///
-/// For now, nothing!
-void
-AddressSpace::SaveState()
-{}
+// Se acabaron los ASID: se vacian las TLB de todos los procesadores, guardando antes sus bits de uso y modificacion.
+static void
+NewAsidGeneration()
+{
+    DEBUG('p', "ASID rollover, generation %u\n", asidGeneration + 1);
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        TranslationEntry *tlb = machine->GetMMU()->GetTlb(cpu);
+        SyncTlbBits(tlb);
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            tlb[i].valid = false;
+        }
+    }
+    for (unsigned a = 0; a < NUM_ASIDS; a++) {
+        asidOwners[a] = nullptr;
+    }
+    asidGeneration++;
+    nextAsid = 0;
 
-TranslationEntry *
-AddressSpace::GetPageTable() {
-    return pageTable;
+    // Los que estan corriendo en los otros procesadores tienen un ASID viejo en el registro, que se va a volver a
+    // repartir: necesitan uno nuevo ya.
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        Thread *thread = scheduler->GetCpuThread(cpu);
+        if (cpu != interrupt->GetCpu() && thread != nullptr && thread->space != nullptr) {
+            thread->space->AssignAsid(cpu);
+        }
+    }
 }
 
-/// On a context switch, restore the machine state so that this address space
-/// can run.
-///
-/// For now, tell the machine where to find the page table.
 void
-AddressSpace::RestoreState()
+AddressSpace::AssignAsid(unsigned cpu)
 {
-    // Comentamos todo lo de la tabla de paginacion para que se pueda usar la TLB
-    #ifndef USE_TLB
-    machine->GetMMU()->pageTable     = pageTable;
-    machine->GetMMU()->pageTableSize = numPages;
+    if (asidOwnerGeneration != asidGeneration && nextAsid == NUM_ASIDS) {
+        NewAsidGeneration();
+    }
+    if (asidOwnerGeneration != asidGeneration) {
+        asid = nextAsid++;
+        asidOwnerGeneration = asidGeneration;
+        asidOwners[asid] = this;
+    }
+    machine->GetMMU()->SetAsid(cpu, asid);
+}
+#endif
+
+#ifdef SWAP
+#ifdef USE_TLB
+// TLB shootdown: si la pagina `vpn` de `space` deja de estar en memoria, hay que invalidarla en las TLB de todos
+// los procesadores, que pueden tener entradas de cualquier espacio de direcciones.
+static void
+ShootdownTLB(AddressSpace *space, unsigned vpn)
+{
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        TranslationEntry *tlb = machine->GetMMU()->GetTlb(cpu);
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            if (tlb[i].valid && tlb[i].virtualPage == vpn && asidOwners[tlb[i].asid] == space) {
+                // Si se modifico desde la ultima sincronizacion hay que saberlo para escribirla en SWAP.
+                space->SyncTlbEntry(&tlb[i]);
+                tlb[i].valid = false;
+            }
+        }
+    }
+}
+#endif
+
+#if defined(USE_TLB) && defined(PV_POLICY_CLOCK)
+// Los bits de uso de la tabla de paginacion se limpian, hay que limpiarlos tambien en las TLB que tengan la pagina,
+// si no se vuelven a copiar en la proxima sincronizacion.
+static void
+ClearTlbUse(AddressSpace *space, unsigned vpn)
+{
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        TranslationEntry *tlb = machine->GetMMU()->GetTlb(cpu);
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            if (tlb[i].valid && tlb[i].virtualPage == vpn && asidOwners[tlb[i].asid] == space) {
+                tlb[i].use = false;
+            }
+        }
+    }
+}
+#endif
+
+#ifdef USE_TLB
+// Antes de elegir una victima, las tablas de paginacion tienen que tener los bits de uso y modificacion que
+// la MMU fue marcando en las TLB de todos los procesadores.
+static void
+SyncAllTlbs()
+{
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        SyncTlbBits(machine->GetMMU()->GetTlb(cpu));
+    }
+}
+#endif
+
+#ifdef PV_POLICY_FIFO
+// Pone `frame`, recien ocupado, al final de la cola de victimas.
+static void
+QueueFrame(int frame)
+{
+    int *a = (int*)malloc(sizeof(int));
+    *a = frame;
+    pvFIFO->Append(a);
+}
+#endif
+
+#if defined(PV_POLICY_CLOCK) || defined(PV_POLICY_AGING)
+// Entrada de la pagina de `frame` en la tabla del `i`-esimo espacio que lo usa. Despues de un Fork, o por el cache
+// de paginas, pueden ser varios, y cada uno marca en la suya los bits de uso y de modificacion.
+static TranslationEntry *
+SharerEntry(unsigned frame, unsigned i)
+{
+    return &coremap->GetSharer(frame, i)->GetPageTable()->Find(coremap->GetVpn(frame))->translation;
+}
+
+// Si alguno de los que usan `frame` lo referencio desde que se limpio su bit de uso.
+static bool
+FrameUsed(unsigned frame)
+{
+    for (unsigned i = 0; i < coremap->GetRefCount(frame); i++) {
+        if (SharerEntry(frame, i)->use) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Si alguno de los que usan `frame` lo modifico.
+static bool
+FrameDirty(unsigned frame)
+{
+    for (unsigned i = 0; i < coremap->GetRefCount(frame); i++) {
+        if (SharerEntry(frame, i)->dirty) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Limpia el bit de uso de `frame` en todos los que lo usan. Con AGING las TLB se limpian enteras al muestrear.
+static void
+ClearFrameUse(unsigned frame)
+{
+    for (unsigned i = 0; i < coremap->GetRefCount(frame); i++) {
+        SharerEntry(frame, i)->use = false;
+#if defined(USE_TLB) && defined(PV_POLICY_CLOCK)
+        ClearTlbUse(coremap->GetSharer(frame, i), coremap->GetVpn(frame));
+#endif
+    }
+}
+#endif
+
+// Si se puede desalojar `frame`: no se esta cargando ni esta fijado, y hay lugar en la SWAP para cada uno de los
+// que lo usan que lo modifico y no tiene donde escribirlo.
+static bool
+CanEvict(unsigned frame)
+{
+    if (!coremap->IsEvictable(frame)) {
+        return false;
+    }
+    if (coremap->GetState(frame) == FRAME_CACHED || swapPartition->CountFree() >= coremap->GetRefCount(frame)) {
+        return true;
+    }
+    unsigned needed = 0;
+    for (unsigned i = 0; i < coremap->GetRefCount(frame); i++) {
+        if (coremap->GetSharer(frame, i)->NeedsSwapSlot(coremap->GetVpn(frame))) {
+            needed++;
+        }
+    }
+    if (needed > swapPartition->CountFree()) {
+        skippedForSwap = true;
+        return false;
+    }
+    return true;
+}
+
+// Una instruccion puede necesitar a la vez su pagina, la de su delay slot y la de su dato.
+static const unsigned MIN_EVICTABLE_FRAMES = 3;
+
+// Cuantos marcos se pueden desalojar ahora.
+static unsigned
+CountEvictable()
+{
+    unsigned count = 0;
+    for (unsigned frame = 0; frame < NUM_PHYS_PAGES; frame++) {
+        if (CanEvict(frame)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Elige un marco que se pueda desalojar segun la politica, o -1 si todos se estan cargando, estan fijados o no
+// tienen donde escribirse.
+static int
+PickVictim()
+{
+#ifdef PV_POLICY_FIFO
+    // Los marcos que se estan cargando o estan fijados vuelven a la cola; los que se liberaron se descartan,
+    // vuelven a entrar cuando se ocupan.
+    for (unsigned requeued = 0; requeued < NUM_PHYS_PAGES && !pvFIFO->IsEmpty(); ) {
+        int *a = pvFIFO->Pop();
+        int frame = *a;
+        if (CanEvict(frame)) {
+            free(a);
+            return frame;
+        }
+        if (coremap->GetState(frame) == FRAME_FREE) {
+            free(a);
+        } else {
+            pvFIFO->Append(a);
+            requeued++;
+        }
+    }
+    return -1;
+#else
+    #ifdef PV_POLICY_CLOCK
+    int i = 0;
+    while (i < 2) {
+        // En la primera pasada, checkeamos por use = false y dirty = false
+        unsigned paginasVisitadas = 0;
+        while (paginasVisitadas < NUM_PHYS_PAGES) {
+            if (CanEvict(pvClock)) {
+                // Las paginas del cache que nadie usa son las primeras victimas.
+                if (coremap->GetState(pvClock) == FRAME_CACHED) {
+                    return pvClock;
+                }
+                if (!FrameUsed(pvClock) && !FrameDirty(pvClock)) {
+                    return pvClock;
+                }
+            }
+            pvClock = (pvClock + 1) % NUM_PHYS_PAGES;
+            paginasVisitadas++;
+        }
+        // En la segunda pasada, checkeamos por use = false y dirty = true. Si no lo cumple, seteamos use = false 
+        paginasVisitadas = 0;
+        while (paginasVisitadas < NUM_PHYS_PAGES) {
+            if (CanEvict(pvClock)) {
+                if (!FrameUsed(pvClock) && FrameDirty(pvClock)) {
+                    return pvClock;
+                }
+                ClearFrameUse(pvClock);
+            }
+            pvClock = (pvClock + 1) % NUM_PHYS_PAGES;
+            paginasVisitadas++;
+        }
+        i++;
+        // Repetimos la primera y segunda pasada, pero ahora estamos seguros que use = false, por lo que se encontrara una pagina
+        // si hay alguna que se pueda desalojar.
+    }
+    return -1;
+    #elif defined(PV_POLICY_AGING)
+    // La de menor edad; entre las de igual edad preferimos una limpia, que no hay que escribir en SWAP.
+    // Se empieza a buscar despues de la ultima victima, para repartir los empates.
+    int victim = -1;
+    unsigned victimAge = 0;
+    bool victimDirty = false;
+    for (unsigned n = 0; n < NUM_PHYS_PAGES; n++) {
+        unsigned frame = (pvClock + n) % NUM_PHYS_PAGES;
+        if (!CanEvict(frame)) {
+            continue;
+        }
+        unsigned age = coremap->GetAge(frame);
+        bool dirty = coremap->GetState(frame) != FRAME_CACHED && FrameDirty(frame);
+        if (victim == -1 || age < victimAge || (age == victimAge && victimDirty && !dirty)) {
+            victim = frame;
+            victimAge = age;
+            victimDirty = dirty;
+        }
+    }
+    if (victim != -1) {
+        pvClock = (victim + 1) % NUM_PHYS_PAGES;
+    }
+    return victim;
     #else
-    for(unsigned int i=0; i<TLB_SIZE; i++) {
-        machine->GetMMU()->tlb[i].valid = false;
+    unsigned start = std::rand() % NUM_PHYS_PAGES;
+    for (unsigned n = 0; n < NUM_PHYS_PAGES; n++) {
+        unsigned frame = (start + n) % NUM_PHYS_PAGES;
+        if (CanEvict(frame)) {
+            return frame;
+        }
+    }
+    return -1;
+    #endif
+#endif
+}
+
+#ifdef PV_POLICY_AGING
+void
+SampleReferenceBits()
+{
+    if (coremap == nullptr) {
+        return;
+    }
+#ifdef USE_TLB
+    // Los bits de uso que importan estan en las TLB; se pasan a las tablas de paginacion y se limpian alli tambien.
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        TranslationEntry *tlb = machine->GetMMU()->GetTlb(cpu);
+        SyncTlbBits(tlb);
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            tlb[i].use = false;
+        }
+    }
+#endif
+    for (unsigned frame = 0; frame < NUM_PHYS_PAGES; frame++) {
+        if (coremap->GetState(frame) == FRAME_IN_USE) {
+            // Una pagina compartida esta en uso si la uso cualquiera de los que la comparten.
+            coremap->Age(frame, FrameUsed(frame));
+            ClearFrameUse(frame);
+        } else if (coremap->GetState(frame) == FRAME_CACHED) {
+            // Nadie la usa.
+            coremap->Age(frame, false);
+        }
+    }
+}
+#endif
+
+bool
+AddressSpace::CommitPages(unsigned count)
+{
+    if (count > commitLimit - committedPages) {
+        return false;
+    }
+    committedPages += count;
+    committed += count;
+    return true;
+}
+
+bool
+AddressSpace::NeedsSwapSlot(int vpn) const
+{
+    const PageTableEntry *entry = pageTable->Find(vpn);
+    return entry != nullptr && entry->translation.dirty && entry->swapSlot == -1 && KindOf(vpn) != PAGE_MAPPED;
+}
+
+bool
+AddressSpace::ReserveSwapSlot(int vpn)
+{
+    PageTableEntry *entry = pageTable->Find(vpn);
+    ASSERT(entry != nullptr);
+    if (entry->swapSlot == -1 && KindOf(vpn) != PAGE_MAPPED) {
+        entry->swapSlot = swapPartition->AllocateSlot();
     }
+    return entry->swapSlot != -1 || KindOf(vpn) == PAGE_MAPPED;
+}
+
+void
+AddressSpace::WriteBackPage(int vpn)
+{
+    PageTableEntry *entry = pageTable->Find(vpn);
+    ASSERT(entry != nullptr);
+    int physical = entry->translation.physicalPage;
+    char* addrMemStart = &machine->GetMMU()->mainMemory[physical * PAGE_SIZE];
+    const Mapping *mapping = FindMapping(vpn);
+    if (mapping != nullptr) {
+        // Solo los bytes del archivo: el resto de la ultima pagina no existe en el.
+        const unsigned start = (vpn - mapping->firstVpn) * PAGE_SIZE;
+        const unsigned bytes = std::min(PAGE_SIZE, mapping->length - start);
+        DEBUG('p', "Escribiendo la pagina %d en su archivo, en la posicion %u\n", vpn, mapping->offset + start);
+        mapping->file->WriteAt(addrMemStart, bytes, mapping->offset + start);
+        stats->numMappedPageWrites++;
+        return;
+    }
+    ASSERT(entry->swapSlot != -1);
+    swapPartition->WritePage(entry->swapSlot, addrMemStart);
+    stats->numSwapWrites++;
+}
+
+void
+AddressSpace::EvictPage(int vpn)
+{
+    PageTableEntry *entry = pageTable->Find(vpn);
+    ASSERT(entry != nullptr && !entry->translation.dirty);
+    // Hay una copia igual: en su lugar de la SWAP si ya se escribio alguna vez, si no en el ejecutable o en su
+    // archivo mapeado (el codigo de solo lectura siempre se vuelve a leer de ahi). En ese caso la pagina esta
+    // como al principio y no necesita entrada en la tabla.
+    if (entry->swapSlot == -1) {
+        pageTable->Remove(vpn);
+        return;
+    }
+    entry->translation.physicalPage = ADDR_IN_SWAP;
+    entry->prefetched = false;
+    if (entry->copyOnWrite) {
+        // La copia que se vuelva a cargar es solo suya.
+        entry->copyOnWrite = false;
+        entry->translation.readOnly = false;
+    }
+}
+
+void
+AddressSpace::CountPrefetchUse(unsigned vpn)
+{
+    PageTableEntry *entry = pageTable->Find(vpn);
+    if (entry != nullptr && entry->prefetched) {
+        entry->prefetched = false;
+        stats->numPrefetchHits++;
+    }
+}
+
+// Desaloja una victima, escribiendola antes en SWAP si esta modificada. Se llama con usedPagesLock tomado,
+// que se suelta mientras se escribe.
+//
+// Si el marco esta compartido despues de un Fork, la pagina sale de todos los espacios que lo usan, y se escribe
+// en la SWAP de cada uno que no tenga otra copia. Si esta en el cache de paginas, sale tambien del cache.
+//
+// Devuelve si se libero un marco; falso si no hay victimas, si no hay lugar en la SWAP para escribir la victima,
+// o si la victima se volvio a modificar mientras se escribia y entonces se queda en memoria.
+static bool
+PageOut()
+{
+#ifdef USE_TLB
+    SyncAllTlbs();
+#endif
+    skippedForSwap = false;
+    int frame = PickVictim();
+    if (frame != -1 && skippedForSwap && CountEvictable() < MIN_EVICTABLE_FRAMES) {
+        // Con la SWAP llena y casi todos los marcos sin poder salir, los pocos que quedan se los roban las
+        // paginas que necesita una misma instruccion y nadie avanza: se toma como que no hay memoria.
+#ifdef PV_POLICY_FIFO
+        QueueFrame(frame);
+#endif
+        frame = -1;
+    }
+    if (frame == -1) {
+        if (skippedForSwap) {
+            pageoutSwapFailures++;
+        }
+        return false;
+    }
+    unsigned vpn = coremap->GetVpn(frame);
+    DEBUG('p', "Pageout de la pagina %u del marco %d\n", vpn, frame);
+    bool written = false;
+    for (;;) {
+        // Mientras se escribe se pueden ir espacios que lo compartian; se vuelven a mirar todos cada vez.
+        AddressSpace *space = nullptr;
+        for (unsigned i = 0; i < coremap->GetRefCount(frame) && space == nullptr; i++) {
+            AddressSpace *sharer = coremap->GetSharer(frame, i);
+#ifdef USE_TLB
+            ShootdownTLB(sharer, vpn);
+#endif
+            if (sharer->GetPageTable()->Find(vpn)->translation.dirty) {
+                space = sharer;
+            }
+        }
+        if (space == nullptr) {
+            break;
+        }
+
+        // Se escribe sin el lock y con la pagina todavia en memoria: el dueño puede seguir usandola. El bit de
+        // modificacion se limpia antes, asi si la vuelve a escribir se sabe que la copia en SWAP (o en su archivo
+        // mapeado) ya no sirve.
+        TranslationEntry *entry = &space->GetPageTable()->Find(vpn)->translation;
+        if (!space->ReserveSwapSlot(vpn)) {
+            // Otro de los que lo comparten tomo el ultimo lugar de la SWAP: se queda en memoria.
+            pageoutSwapFailures++;
+#ifdef PV_POLICY_FIFO
+            QueueFrame(frame);
+#endif
+            return false;
+        }
+        entry->dirty = false;
+        coremap->Pin(frame);
+        pageoutCleaning = space;
+        usedPagesLock->Release();
+        space->WriteBackPage(vpn);
+        usedPagesLock->Acquire();
+        pageoutCleaning = nullptr;
+        coremap->Unpin(frame);
+        pageoutDone->Broadcast();
+        written = true;
+#ifdef USE_TLB
+        ShootdownTLB(space, vpn);
+#endif
+        // Tambien se deja si mientras tanto otro la fijo, para copiarla antes de escribirla.
+        if (entry->dirty || !coremap->IsEvictable(frame)) {
+#ifdef PV_POLICY_FIFO
+            QueueFrame(frame);
+#endif
+            return false;
+        }
+    }
+    if (!written) {
+        stats->numCleanEvictions++;
+    }
+    // El ultimo que deja el marco lo libera; si no lo usaba nadie, se libera ahora.
+    pageCache->Remove(frame);
+    coremap->SetCached(frame, false);
+    if (coremap->GetState(frame) == FRAME_CACHED) {
+        coremap->Free(frame);
+    }
+    while (coremap->GetState(frame) != FRAME_FREE) {
+        AddressSpace *space = coremap->GetOwner(frame);
+        space->EvictPage(vpn);
+        coremap->Unshare(frame, space);
+    }
+    machine->GetMMU()->InvalidateTranslationCache();
+    return true;
+}
+
+// Si hay algun thread listo para correr, en cualquier procesador.
+static bool
+OthersReady()
+{
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        if (scheduler->HasReadyThreads(cpu)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+ZeroDaemon(void *)
+{
+    for (;;) {
+        zeroerWaiting = true;
+        zeroIdle->P();
+
+        // De a un marco, y se deja en cuanto hay otro listo para correr: se retoma la proxima vez que sobre tiempo.
+        usedPagesLock->Acquire();
+        int frame;
+        while (coremap->CountZeroed() < zeroPoolSize && !OthersReady()
+                 && (frame = coremap->FindUnzeroed()) != -1) {
+            memset(&machine->GetMMU()->mainMemory[frame * PAGE_SIZE], 0, PAGE_SIZE);
+            coremap->SetZeroed(frame);
+            // Al soltar el lock pueden llegar interrupciones que despierten a alguien.
+            usedPagesLock->Release();
+            usedPagesLock->Acquire();
+        }
+        usedPagesLock->Release();
+    }
+}
+
+// Trabajo para cuando un procesador se queda sin threads listos: despierta al daemon de ceros si faltan marcos en
+// cero. Corre con las interrupciones deshabilitadas, no puede tomar usedPagesLock; cada operacion del coremap es
+// atomica igual.
+static bool
+ZeroWhenIdle()
+{
+    if (!zeroerWaiting || coremap->CountZeroed() >= zeroPoolSize || coremap->FindUnzeroed() == -1) {
+        return false;
+    }
+    zeroerWaiting = false;
+    zeroIdle->V();
+    return true;
+}
+
+// Espera a que el daemon de paginacion libere un marco, y lo toma para la pagina `vpn` de `space`. Se llama con
+// usedPagesLock tomado.
+//
+// Devuelve -1 si el daemon no pudo liberar ninguno porque la SWAP esta llena: no hay donde poner la pagina.
+static int
+WaitForFrame(AddressSpace *space, unsigned vpn)
+{
+    int physical = -1;
+    while (physical == -1) {
+        DEBUG('p', "Memoria llena, esperando al daemon de paginacion\n");
+        const unsigned failures = pageoutSwapFailures;
+        pageoutWanted->Signal();
+        pageoutDone->Wait();
+        physical = coremap->Allocate(space, vpn);
+        if (physical == -1 && pageoutSwapFailures != failures) {
+            DEBUG('p', "Particion de swap llena, no se puede liberar ningun marco\n");
+            return -1;
+        }
+    }
+    return physical;
+}
+
+static void
+PageoutDaemon(void *)
+{
+    usedPagesLock->Acquire();
+    for (;;) {
+        // Si no se pudo liberar un marco se espera a que lo vuelvan a pedir, o a que se termine de cargar alguna
+        // pagina que se pueda desalojar.
+        while (coremap->CountFree() < pageoutHigh && PageOut()) {
+        }
+        pageoutDone->Broadcast();
+        pageoutWanted->Wait();
+    }
+}
+
+
+bool
+AddressSpace::LoadPageFromSWAP(int vpn, int physical){
+    PageTableEntry *entry = pageTable->Find(vpn);
+    ASSERT(entry != nullptr && entry->swapSlot != -1);
+    char* addrMemStart = &machine->GetMMU()->mainMemory[physical * PAGE_SIZE];
+    swapPartition->ReadPage(entry->swapSlot, addrMemStart);
+    stats->numSwapReads++;
+
+    entry->translation.virtualPage  = vpn;
+    entry->translation.physicalPage = physical;
+    entry->translation.valid        = true;
+    //entry->translation.use          = false;
+    //entry->translation.dirty        = false;
+
+    return true;
+}
+
+unsigned
+AddressSpace::SegmentOf(unsigned vpn) const
+{
+    const Mapping *mapping = FindMapping(vpn);
+    if (mapping != nullptr) {
+        return 3 + mapping->firstVpn;
+    }
+    const uint32_t pageAddrStart = vpn * PAGE_SIZE;
+    if (codeSize > 0 && pageAddrStart >= codeAddrStart && pageAddrStart <= codeAddrEnd) {
+        return 0;
+    }
+    if (initDataSize > 0 && pageAddrStart >= initDataAddrStart && pageAddrStart <= initDataAddrEnd) {
+        return 1;
+    }
+    return 2;
+}
+
+void
+AddressSpace::FaultAround(unsigned vpn, int source)
+{
+    // Se toman las paginas siguientes del mismo segmento que estan donde estaba la que fallo (todas en el
+    // ejecutable o todas en SWAP), solo de los marcos libres que sobran por encima de pageoutLow: adelantar una
+    // lectura no justifica desalojar a nadie.
+    const unsigned segment = SegmentOf(vpn);
+    int *frames = new int [faultAroundPages - 1];
+    unsigned count = 0;
+
+    usedPagesLock->Acquire();
+    for (unsigned next = vpn + 1; next < numPages && count < faultAroundPages - 1; next++) {
+        // Las paginas que estan en el cache de paginas se comparten cuando fallen, no se leen otra vez.
+        const PageTableEntry *entry = pageTable->Find(next);
+        if ((entry == nullptr ? NOT_LOAD_ADDR : entry->translation.physicalPage) != source
+              || SegmentOf(next) != segment
+              || coremap->CountFree() <= pageoutLow
+              || (source == NOT_LOAD_ADDR && KindOf(next) == PAGE_ZERO)
+              || (IsTextPage(next) && pageCache->Find(executableSector, executableVersion, next) != -1)) {
+            break;
+        }
+        frames[count] = coremap->Allocate(this, next);
+        ASSERT(frames[count] != -1);
+#ifdef PV_POLICY_FIFO
+        QueueFrame(frames[count]);
+#endif
+        count++;
+    }
+    usedPagesLock->Release();
+    if (count == 0) {
+        delete [] frames;
+        return;
+    }
+
+    DEBUG('p', "Fault-around: %u paginas despues de la %u\n", count, vpn);
+    for (unsigned i = 0; i < count; i++) {
+        machine->GetMMU()->InvalidateDecodedFrame(frames[i]);
+    }
+    // Del ejecutable se leen todas juntas; en la SWAP cada pagina tiene su lugar, que no tienen por que ser contiguos.
+    // Las de un archivo mapeado se leen cada una directo a su marco.
+    if (source == NOT_LOAD_ADDR && KindOf(vpn) == PAGE_MAPPED) {
+        for (unsigned i = 0; i < count; i++) {
+            LoadPageFromFile(vpn + 1 + i, frames[i]);
+        }
+    } else if (source == NOT_LOAD_ADDR) {
+        LoadPagesFromCode(vpn + 1, count, frames);
+    } else {
+        for (unsigned i = 0; i < count; i++) {
+            LoadPageFromSWAP(vpn + 1 + i, frames[i]);
+        }
+    }
+    for (unsigned i = 0; i < count; i++) {
+        // Sin el bit de uso, para que el reemplazo no las confunda con paginas que se usaron.
+        PageTableEntry *entry = pageTable->Find(vpn + 1 + i);
+        entry->translation.use   = false;
+        entry->translation.dirty = false;
+        entry->prefetched = true;
+    }
+
+    usedPagesLock->Acquire();
+    for (unsigned i = 0; i < count; i++) {
+        if (source == NOT_LOAD_ADDR) {
+            CachePage(vpn + 1 + i, frames[i]);
+        }
+        coremap->SetLoaded(frames[i]);
+    }
+    usedPagesLock->Release();
+    stats->numPagesPrefetched += count;
+    delete [] frames;
+}
+
+void
+AddressSpace::LoadPageFromFile(unsigned vpn, int physical)
+{
+    const Mapping *mapping = FindMapping(vpn);
+    ASSERT(mapping != nullptr);
+    const unsigned start = (vpn - mapping->firstVpn) * PAGE_SIZE;
+    const unsigned bytes = std::min(PAGE_SIZE, mapping->length - start);
+
+    // Sin pasar por un buffer del kernel: el archivo se lee directo al marco, y lo que sobra despues del final
+    // queda en cero.
+    char *frame = &machine->GetMMU()->mainMemory[physical * PAGE_SIZE];
+    DEBUG('p', "Leyendo la pagina %u de su archivo, desde la posicion %u\n", vpn, mapping->offset + start);
+    int read = mapping->file->ReadAt(frame, bytes, mapping->offset + start);
+    memset(&frame[std::max(read, 0)], 0, PAGE_SIZE - std::max(read, 0));
+    stats->numMappedPageReads++;
+
+    TranslationEntry *page = &pageTable->Enter(vpn)->translation;
+    page->virtualPage  = vpn;
+    page->physicalPage = physical;
+    page->valid        = true;
+    page->readOnly     = false;
+}
+
+AddressSpace::Mapping *
+AddressSpace::FindMapping(unsigned vpn) const
+{
+    for (Mapping *mapping = mappings; mapping != nullptr; mapping = mapping->next) {
+        if (vpn >= mapping->firstVpn + mapping->numPages) {
+            return nullptr;  // Estan de mayor a menor, las que siguen estan mas abajo.
+        }
+        if (vpn >= mapping->firstVpn) {
+            return mapping;
+        }
+    }
+    return nullptr;
+}
+
+int
+AddressSpace::Map(OpenFile *file, unsigned offset, unsigned length)
+{
+    ASSERT(file != nullptr);
+
+    const unsigned fileLength = file->Length();
+    if (offset >= fileLength) {
+        return -1;
+    }
+    if (length == 0 || length > fileLength - offset) {
+        length = fileLength - offset;
+    }
+    const unsigned count = DivRoundUp(length, PAGE_SIZE);
+
+    // El primer hueco, bajando desde el stack hasta el heap, donde entren todas las paginas; se ponen lo mas arriba
+    // posible.
+    usedPagesLock->Acquire();
+    Mapping **link = &mappings;
+    unsigned top = numPages - stackPages;
+    while (*link != nullptr && top - ((*link)->firstVpn + (*link)->numPages) < count) {
+        top = (*link)->firstVpn;
+        link = &(*link)->next;
+    }
+    if (*link == nullptr && top - (imagePages + heapPages) < count) {
+        usedPagesLock->Release();
+        DEBUG('p', "No hay lugar para mapear %u paginas\n", count);
+        return -1;
+    }
+
+    Mapping *mapping = new Mapping;
+    mapping->firstVpn = top - count;
+    mapping->numPages = count;
+    mapping->file     = file;
+    mapping->offset   = offset;
+    mapping->length   = length;
+    mapping->next     = *link;
+    *link = mapping;
+    usedPagesLock->Release();
+
+    DEBUG('p', "Archivo mapeado en las paginas %u a %u, desde la posicion %u (%u bytes)\n",
+          mapping->firstVpn, mapping->firstVpn + count - 1, offset, length);
+    return mapping->firstVpn;
+}
+
+bool
+AddressSpace::Unmap(unsigned vpn)
+{
+    usedPagesLock->Acquire();
+    Mapping **link = &mappings;
+    while (*link != nullptr && (*link)->firstVpn != vpn) {
+        link = &(*link)->next;
+    }
+    if (*link == nullptr) {
+        usedPagesLock->Release();
+        return false;
+    }
+    Mapping *mapping = *link;
+
+    for (unsigned page = mapping->firstVpn; page < mapping->firstVpn + mapping->numPages; page++) {
+        // Si el daemon esta escribiendo una pagina nuestra, puede ser esta: tiene que seguir en su marco.
+        while (pageoutCleaning == this) {
+            pageoutDone->Wait();
+        }
+        PageTableEntry *entry = pageTable->Find(page);
+        if (entry == nullptr) {
+            continue;  // Nunca se cargo, o se desalojo: el archivo esta al dia.
+        }
+        int physical = entry->translation.physicalPage;
+        if (physical < 0) {
+            // Nunca van a la SWAP: es una carga que no consiguio marco, y el proceso termina.
+            pageTable->Remove(page);
+            continue;
+        }
+#ifdef USE_TLB
+        // Trae tambien el bit de modificacion de las TLB.
+        ShootdownTLB(this, page);
+#endif
+        if (entry->translation.dirty) {
+            // Mientras se escribe el marco no se puede desalojar.
+            entry->translation.dirty = false;
+            coremap->Pin(physical);
+            usedPagesLock->Release();
+            WriteBackPage(page);
+            usedPagesLock->Acquire();
+            coremap->Unpin(physical);
+        }
+        coremap->Unshare(physical, this);
+        pageTable->Remove(page);
+    }
+
+    // Ya no queda ninguna pagina suya que el daemon pueda estar escribiendo.
+    *link = mapping->next;
+    usedPagesLock->Release();
+    machine->GetMMU()->InvalidateTranslationCache();
+
+    DEBUG('p', "Desmapeadas las paginas %u a %u\n", mapping->firstVpn,
+          mapping->firstVpn + mapping->numPages - 1);
+    delete mapping;
+    return true;
+}
+
+void
+AddressSpace::CachePage(unsigned vpn, int frame)
+{
+    // Si otro proceso la cargo al mismo tiempo, queda la suya.
+    if (IsTextPage(vpn) && pageCache->Find(executableSector, executableVersion, vpn) == -1) {
+        pageCache->Insert(executableSector, executableVersion, vpn, frame);
+        coremap->SetCached(frame, true);
+    }
+}
+#endif
+
+void
+AddressSpace::LoadPage(int vpn) {
+// Si SWAP no esta activada ------------------------------------------------------------------
+    // Recien cargada la pagina es igual a su copia (en el ejecutable o en SWAP); la MMU marca si se modifica.
+    TranslationEntry *page = &pageTable->Enter(vpn)->translation;
+    page->use          = true;
+    page->dirty        = false;
+    bool zeroed = false;  // Si el marco ya esta lleno de ceros.
+#ifndef SWAP
+    usedPagesLock->Acquire();
+    if (usedPages->CountClear() == 0) {
+        DEBUG('p', "Memoria llena, no se puede cargar la pagina.\n");
+        fullMemory = true;
+        usedPagesLock->Release();
+        return;
+        // El programa no puede continuar ejecutandose.
+    }
+    
+    DEBUG('p', "used: %d\n", usedPages->CountClear());
+    const int physical = usedPages->Find();
+    usedPagesLock->Release();
+#else
+// Si SWAP esta activada ---------------------------------------------------------------------
+    DEBUG('p', "LoadPage\n");
+    usedPagesLock->Acquire();
+    // Si otro proceso que corre el mismo programa ya tiene la pagina de codigo en memoria, se usa la misma. Una
+    // que se esta cargando todavia no se puede usar; se carga otra copia.
+    if (page->physicalPage == NOT_LOAD_ADDR && IsTextPage(vpn)) {
+        int cached = pageCache->Find(executableSector, executableVersion, vpn);
+        if (cached != -1 && coremap->GetState(cached) != FRAME_LOADING) {
+            DEBUG('p', "Pagina %d del cache de paginas, en el marco %d\n", vpn, cached);
+            coremap->Share(cached, this);
+            page->virtualPage  = vpn;
+            page->physicalPage = cached;
+            page->valid        = true;
+            page->readOnly     = true;
+            stats->numPageCacheHits++;
+            usedPagesLock->Release();
+            machine->GetMMU()->InvalidateTranslationCache();
+            return;
+        }
+    }
+    // Las paginas que empiezan en cero toman, si hay, un marco que el daemon de ceros ya lleno.
+    int physical = -1;
+    if (page->physicalPage == NOT_LOAD_ADDR && KindOf(vpn) == PAGE_ZERO) {
+        physical = coremap->AllocateZeroed(this, vpn);
+        zeroed = physical != -1;
+    }
+    // Los marcos libres los repone el daemon de paginacion; si no queda ninguno hay que esperarlo.
+    if (physical == -1) {
+        physical = coremap->Allocate(this, vpn);
+    }
+    if (physical == -1) {
+        physical = WaitForFrame(this, vpn);
+    }
+    if (physical == -1) {
+        // No hay memoria para la pagina: el programa no puede seguir.
+        fullMemory = true;
+        usedPagesLock->Release();
+        return;
+    }
+    if (coremap->CountFree() < pageoutLow) {
+        pageoutWanted->Signal();
+    }
+#ifdef PV_POLICY_FIFO
+    QueueFrame(physical);
+#endif
+    usedPagesLock->Release();
+#endif
+    // El marco va a cambiar de contenido, las instrucciones decodificadas que tenia ya no sirven.
+    machine->GetMMU()->InvalidateDecodedFrame(physical);
+
+    // Ahora tenemos una pagina disponible en memoria. Hay que ver de donde se carga la información.
+#ifdef SWAP
+    const int source = page->physicalPage;  // Para el fault-around.
+#endif
+    if (page->physicalPage == NOT_LOAD_ADDR && KindOf(vpn) == PAGE_ZERO) {
+        // Nunca se cargo, y no tiene nada del ejecutable.
+        ZeroFillPage(vpn, physical, zeroed);
+#ifdef SWAP
+    } else if (page->physicalPage == NOT_LOAD_ADDR && KindOf(vpn) == PAGE_MAPPED) {
+        // Nunca se cargo, o se desalojo limpia: esta en su archivo.
+        LoadPageFromFile(vpn, physical);
+#endif
+    } else if (page->physicalPage == NOT_LOAD_ADDR) {
+        // Nunca se cargo, (LoadFromCode)
+        DEBUG('p', "Leyendo de archivo");
+        LoadPageFromCode(vpn, physical);
+    }
+#ifdef SWAP
+    if (page->physicalPage == ADDR_IN_SWAP) {
+        DEBUG('p', "Leyendo de SWAP");
+        ASSERT(LoadPageFromSWAP(vpn, physical)); // Si el ASSERT va a ser eliminado, checkear la llamada porque pageTable queda incorrecta
+    }
+    // Mientras se leen las siguientes la pagina que fallo sigue cargandose, asi el daemon no la desaloja antes de
+    // que se use. Las paginas en cero no se leen de ningun lado, no hay lecturas que juntar.
+    if (faultAroundPages > 1 && !(source == NOT_LOAD_ADDR && KindOf(vpn) == PAGE_ZERO)) {
+        FaultAround(vpn, source);
+    }
+
+    usedPagesLock->Acquire();
+    if (source == NOT_LOAD_ADDR) {
+        CachePage(vpn, physical);
+    }
+    coremap->SetLoaded(physical);
+    // El daemon puede estar esperando a que haya una pagina para desalojar.
+    if (coremap->CountFree() < pageoutLow) {
+        pageoutWanted->Signal();
+    }
+    usedPagesLock->Release();
+#endif
+    // Cambiaron la TLB y las tablas de paginacion, las traducciones que recuerda la MMU pueden estar viejas.
+    machine->GetMMU()->InvalidateTranslationCache();
+    return;
+}
+
+bool
+AddressSpace::CopyOnWrite(unsigned vpn)
+{
+#ifndef SWAP
+    // Sin SWAP los Fork copian todas las paginas, nunca se comparten.
+    return false;
+#else
+    if (vpn >= numPages) {
+        return false;
+    }
+    usedPagesLock->Acquire();
+    // Si el daemon esta escribiendo una pagina nuestra, tiene que seguir en el marco en que la encontro.
+    while (pageoutCleaning == this) {
+        pageoutDone->Wait();
+    }
+    PageTableEntry *entry = pageTable->Find(vpn);
+    // Mientras se esperaba, el daemon pudo haberla desalojado (y deja de ser copy-on-write), o ya se pudo haber
+    // copiado: se vuelve a ejecutar la instruccion, que falla de nuevo si hace falta.
+    if (entry == nullptr || entry->translation.physicalPage < 0 || !entry->translation.readOnly) {
+#ifdef USE_TLB
+        ShootdownTLB(this, vpn);
+#endif
+        usedPagesLock->Release();
+        machine->GetMMU()->InvalidateTranslationCache();
+        return true;
+    }
+    if (!entry->copyOnWrite) {
+        usedPagesLock->Release();
+        return false;
+    }
+
+    // Mientras tanto alguno de los que la compartian pudo haber terminado o hecho su propia copia; si ya es
+    // solo nuestra no hace falta copiarla.
+    int shared = entry->translation.physicalPage;
+    ASSERT(shared >= 0);  // Al desalojarla deja de ser copy-on-write.
+    if (coremap->GetRefCount(shared) > 1) {
+        // Mientras se espera un marco libre, el compartido no se puede desalojar.
+        coremap->Pin(shared);
+        int physical = coremap->Allocate(this, vpn);
+        if (physical == -1) {
+            physical = WaitForFrame(this, vpn);
+        }
+        if (physical == -1) {
+            // No hay memoria para la copia: el programa no puede seguir.
+            coremap->Unpin(shared);
+            fullMemory = true;
+            usedPagesLock->Release();
+            return true;
+        }
+        if (coremap->CountFree() < pageoutLow) {
+            pageoutWanted->Signal();
+        }
+        DEBUG('p', "Copy-on-write de la pagina %u, del marco %d al %d\n", vpn, shared, physical);
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        memcpy(&mainMemory[physical * PAGE_SIZE], &mainMemory[shared * PAGE_SIZE], PAGE_SIZE);
+        machine->GetMMU()->InvalidateDecodedFrame(physical);
+        coremap->Unpin(shared);
+        coremap->Unshare(shared, this);
+        entry->translation.physicalPage = physical;
+#ifdef PV_POLICY_FIFO
+        QueueFrame(physical);
+#endif
+        coremap->SetLoaded(physical);
+        stats->numPagesCopiedOnWrite++;
+    }
+    entry->translation.readOnly = false;
+    entry->copyOnWrite = false;
+#ifdef USE_TLB
+    ShootdownTLB(this, vpn);
+#endif
+    usedPagesLock->Release();
+    machine->GetMMU()->InvalidateTranslationCache();
+    return true;
+#endif
+}
+
+const char *
+AddressSpace::GetExecutableName() const
+{
+    return executableName;
+}
+
+void
+AddressSpace::SaveCheckpoint(int fd)
+{
+    // Solo se guardan las paginas que tienen entrada en la tabla; las demas estan como al principio.
+    unsigned count = 0;
+    TranslationEntry *entries = new TranslationEntry [pageTable->CountEntries()];
+    for (PageTableEntry *entry = pageTable->First(); entry != nullptr; entry = pageTable->Next(entry)) {
+        entries[count] = entry->translation;
+#ifdef SWAP
+        // Al restaurar las paginas son solo de este programa: las compartidas despues de un Fork se pueden escribir.
+        entries[count].readOnly = entry->translation.readOnly && !entry->copyOnWrite;
+#endif
+        count++;
+    }
+    SystemDep::WriteFile(fd, (char *) &numPages, sizeof numPages);
+    SystemDep::WriteFile(fd, (char *) &heapPages, sizeof heapPages);
+    SystemDep::WriteFile(fd, (char *) &count, sizeof count);
+    SystemDep::WriteFile(fd, (char *) entries, count * sizeof *entries);
+#ifdef SWAP
+    // Las paginas que estan en SWAP no estan en la memoria fisica, se guardan aparte, en el mismo orden.
+    char *page = new char [PAGE_SIZE];
+    for (unsigned i = 0; i < count; i++) {
+        if (entries[i].physicalPage == ADDR_IN_SWAP) {
+            swapPartition->ReadPageUntimed(pageTable->Find(entries[i].virtualPage)->swapSlot, page);
+            SystemDep::WriteFile(fd, page, PAGE_SIZE);
+        }
+    }
+    delete [] page;
+#endif
+    delete [] entries;
+#ifdef SWAP
+#ifdef PV_POLICY_FIFO
+    // El orden de la cola decide las proximas victimas.
+    List<int*> *saved = new List<int*>;
+    unsigned queued = 0;
+    for (int *frame; (frame = pvFIFO->Pop()) != nullptr; queued++) {
+        saved->Append(frame);
+    }
+    SystemDep::WriteFile(fd, (char *) &queued, sizeof queued);
+    for (int *frame; (frame = saved->Pop()) != nullptr; ) {
+        SystemDep::WriteFile(fd, (char *) frame, sizeof *frame);
+        pvFIFO->Append(frame);
+    }
+    delete saved;
+#endif
+#if defined(PV_POLICY_CLOCK) || defined(PV_POLICY_AGING)
+    SystemDep::WriteFile(fd, (char *) &pvClock, sizeof pvClock);
+#endif
+#endif
+}
+
+void
+AddressSpace::RestoreCheckpoint(int fd)
+{
+    unsigned savedPages;
+    SystemDep::Read(fd, (char *) &savedPages, sizeof savedPages);
+    ASSERT(savedPages == numPages);
+    SystemDep::Read(fd, (char *) &heapPages, sizeof heapPages);
+
+    // Liberamos los marcos que se usaron al crear el espacio, el checkpoint dice cuales son los nuestros.
+    usedPagesLock->Acquire();
+#ifdef SWAP
+    // Al crearlo se contaron el programa y el stack; falta el heap del programa guardado.
+    bool committedHeap = CommitPages(heapPages);
+    ASSERT(committedHeap);
+#endif
+    for (PageTableEntry *entry = pageTable->First(); entry != nullptr; entry = pageTable->Next(entry)) {
+        int physical = entry->translation.physicalPage;
+        if (physical != NOT_LOAD_ADDR && physical != ADDR_IN_SWAP) {
+#ifndef SWAP
+            usedPages->Clear(physical);
+#else
+            coremap->Free(physical);
+#endif
+        }
+#ifdef SWAP
+        if (entry->swapSlot != -1) {
+            swapPartition->FreeSlot(entry->swapSlot);
+        }
+#endif
+    }
+    delete pageTable;
+    pageTable = new PageTable(numPages);
+
+    unsigned count;
+    SystemDep::Read(fd, (char *) &count, sizeof count);
+    TranslationEntry *entries = new TranslationEntry [count];
+    SystemDep::Read(fd, (char *) entries, count * sizeof *entries);
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(entries[i].virtualPage < numPages);
+        TranslationEntry *page = &pageTable->Enter(entries[i].virtualPage)->translation;
+        *page = entries[i];
+        int physical = page->physicalPage;
+        if (physical != NOT_LOAD_ADDR && physical != ADDR_IN_SWAP) {
+#ifndef SWAP
+            usedPages->Mark(physical);
+#else
+            coremap->Take(physical, this, page->virtualPage);
+            // Su copia en la SWAP del programa guardado no se trae: si se puede escribir, hay que escribirla
+            // al desalojarla aunque no haya cambiado.
+            page->dirty |= !page->readOnly;
+#endif
+        }
+    }
+#ifdef SWAP
+    // Despues se reemplaza toda la memoria fisica por la del programa guardado: los marcos libres ya no tienen ceros.
+    coremap->ForgetZeroed();
+#endif
+    usedPagesLock->Release();
+
+#ifdef SWAP
+    // Las paginas en SWAP van a lugares nuevos de la particion, los del programa guardado no existen en esta.
+    char *page = new char [PAGE_SIZE];
+    for (unsigned i = 0; i < count; i++) {
+        if (entries[i].physicalPage == ADDR_IN_SWAP) {
+            SystemDep::Read(fd, page, PAGE_SIZE);
+            PageTableEntry *entry = pageTable->Find(entries[i].virtualPage);
+            usedPagesLock->Acquire();
+            entry->swapSlot = swapPartition->AllocateSlot();
+            usedPagesLock->Release();
+            ASSERT(entry->swapSlot != -1);
+            swapPartition->WritePageUntimed(entry->swapSlot, page);
+        }
+    }
+    delete [] page;
+#endif
+    delete [] entries;
+#ifdef SWAP
+#ifdef PV_POLICY_FIFO
+    for (int *frame; (frame = pvFIFO->Pop()) != nullptr; ) {
+        free(frame);
+    }
+    unsigned queued;
+    SystemDep::Read(fd, (char *) &queued, sizeof queued);
+    for (unsigned i = 0; i < queued; i++) {
+        int *frame = (int*)malloc(sizeof(int));
+        SystemDep::Read(fd, (char *) frame, sizeof *frame);
+        pvFIFO->Append(frame);
+    }
+#endif
+#if defined(PV_POLICY_CLOCK) || defined(PV_POLICY_AGING)
+    SystemDep::Read(fd, (char *) &pvClock, sizeof pvClock);
+#endif
+#endif
+    DEBUG('a', "Restored user address space of %s\n", executableName);
+}
+
+/// Set the initial values for the user-level register set.
+///
+/// We write these directly into the â€œmachineâ€ registers, so that we can
+/// immediately jump to user code.  Note that these will be saved/restored
+/// into the `currentThread->userRegisters` when this thread is context
+/// switched out.
+void
+AddressSpace::InitRegisters()
+{
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, 0);
+    }
+
+    // Initial program counter -- must be location of `Start`.
+    machine->WriteRegister(PC_REG, 0);
+
+    // Need to also tell MIPS where next instruction is, because of branch
+    // delay possibility.
+    machine->WriteRegister(NEXT_PC_REG, 4);
+
+    // Set the stack register to the end of the address space, where we
+    // allocated the stack; but subtract off a bit, to make sure we do not
+    // accidentally reference off the end!
+    machine->WriteRegister(STACK_REG, numPages * PAGE_SIZE - 16);
+    DEBUG('a', "Initializing stack register to %u\n",
+          numPages * PAGE_SIZE - 16);
+}
+
+/// On a context switch, save any machine state, specific to this address
+/// space, that needs saving.
+///
+/// For now, nothing!  With a TLB, entries are tagged with the address
+/// space, so they can stay.
+void
+AddressSpace::SaveState()
+{}
+
+#ifdef USE_TLB
+void
+AddressSpace::SyncTlbEntry(const TranslationEntry *entry)
+{
+    ASSERT(entry != nullptr);
+
+    unsigned vpn = entry->virtualPage;
+    // Las entradas de paginas que ya no estan en ese marco son viejas, no hay nada que copiar.
+    if (!entry->valid || vpn >= numPages) {
+        return;
+    }
+    PageTableEntry *page = pageTable->Find(vpn);
+    if (page == nullptr || page->translation.physicalPage != entry->physicalPage) {
+        return;
+    }
+    page->translation.use   |= entry->use;
+    page->translation.dirty |= entry->dirty;
+}
+#endif
+
+PageTable *
+AddressSpace::GetPageTable() {
+    return pageTable;
+}
+
+/// On a context switch, restore the machine state so that this address space
+/// can run.
+///
+/// For now, tell the machine where to find the page table.
+void
+AddressSpace::RestoreState()
+{
+    // Comentamos todo lo de la tabla de paginacion para que se pueda usar la TLB
+    #ifndef USE_TLB
+    machine->GetMMU()->pageTable = pageTable;
+    #else
+    // Las entradas de la TLB llevan el ASID, no hace falta invalidarlas: alcanza con cambiar el del procesador.
+    AssignAsid(interrupt->GetCpu());
     #endif
+    machine->GetMMU()->InvalidateTranslationCache();
+    machine->SetProfile(profile);
 }
@@ -16,12 +16,59 @@
 #include <algorithm>
 #include "filesys/file_system.hh"
 #include "executable.hh"
+#include "machine/profile.hh"
 #include "machine/translation_entry.hh"
+#include "page_table.hh"
 #include "filesys/directory_entry.hh" //FILENAME_MAX_LEN
 #include <stdint.h>
 
 const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
 
+/// Size of the virtual address space of every program, unless the program
+/// and its stack do not fit.
+///
+/// The program is loaded at the bottom, followed by its heap, and the stack
+/// goes at the top; files are mapped in between, below the stack.  Pages
+/// that are none of these cannot be used, and take no memory.
+const unsigned USER_ADDRESS_SPACE_SIZE = 16 * 1024 * 1024;
+
+
+/// Create the tables of the physical frames in use.
+///
+/// Must be called once, after the size of the machine is settled.
+void InitFrameTables();
+
+#ifdef SWAP
+/// Number of pages a page fault loads: the faulting one and the following
+/// ones of its segment that are not in memory, while there are free frames.
+/// 1 loads only the faulting page.
+extern unsigned faultAroundPages;
+#endif
+
+#if defined(SWAP) && defined(PV_POLICY_AGING)
+/// Shift the use bit of the page held by every frame into the age of the
+/// frame, and clear it, for the aging replacement policy.
+///
+/// Called periodically, on timer interrupts.
+void SampleReferenceBits();
+#endif
+
+#ifdef USE_TLB
+/// Copy the use and dirty bits of the valid entries of `tlb` to the page
+/// tables of the address spaces they belong to.
+void SyncTlbBits(const TranslationEntry *tlb);
+#endif
+
+/// What a page holds when the program starts, which tells how to load it
+/// the first time.
+enum PageKind {
+    PAGE_TEXT,  ///< Only code: read-only, and shared in the page cache.
+    PAGE_FILE,  ///< Some initialized data, read from the executable.
+    PAGE_ZERO,  ///< Only uninitialized data or stack: starts out as zeros,
+                ///< nothing is read.
+    PAGE_MAPPED ///< Part of a file mapped with `Map`: read from the file,
+                ///< and written back to it.
+};
 
 class AddressSpace {
 public:
@@ -36,7 +83,22 @@ public:
     /// Parameters:
     /// * `executable_file` is the open file that corresponds to the
     ///   program; it contains the object code to load into memory.
-    AddressSpace(OpenFile *executable_file, int pid);
+    /// * `name` is the name it was opened with.
+    AddressSpace(OpenFile *executable_file, int pid, const char *name);
+
+    /// Create an address space for the child of a `Fork`, with the same
+    /// pages as `parent`.
+    ///
+    /// With swapping, the pages in memory are not copied: parent and child
+    /// share their frames read-only, and the first one that writes a page
+    /// gets a copy of its own (see `CopyOnWrite`).  Otherwise the frames are
+    /// copied right away.  `fullMemory` is set if there are not enough free
+    /// frames, or slots in the swap partition for the pages the parent has
+    /// there.
+    ///
+    /// * `executable_file` is the executable of `parent` opened again, for
+    ///   the pages the parent has not loaded yet.
+    AddressSpace(AddressSpace *parent, OpenFile *executable_file, int pid);
 
     /// De-allocate an address space.
     ~AddressSpace();
@@ -51,18 +113,135 @@ public:
 
     //bool isMemoryFull();
 
-    TranslationEntry * GetPageTable();
+    /// The page table: an entry for every page loaded and not dropped
+    /// since.  A page without one is not in memory, and has its initial
+    /// contents.
+    PageTable *GetPageTable();
 
+    /// Bring page `vpn` into memory.  Sets `fullMemory` if there is no
+    /// frame for it: all are taken and, with swapping, the ones that could
+    /// be evicted have no room left in the swap partition.
     void LoadPage(int vpn);
 
+    /// Whether page `vpn` can be used: it belongs to the program, to the
+    /// heap, to the stack or to a mapped file.
+    bool IsValidPage(unsigned vpn) const;
+
+    /// Grow the heap, which starts at the first page after the program, by
+    /// `count` pages.  They start out as zeros: with demand loading they
+    /// are filled on their first fault, otherwise right away.
+    ///
+    /// Returns the first new page, or -1 if the heap would reach a mapped
+    /// file or the stack, or there is not enough memory for it: free frames
+    /// or, with swapping, frames and swap slots left to back it.
+    int GrowHeap(unsigned count);
+
+#ifdef USE_TLB
+    /// Copy the use and dirty bits that the MMU set in `entry`, a TLB entry
+    /// for this address space, to the page table.
+    ///
+    /// The TLB holds copies of page table entries, so the bits must be
+    /// copied back before the entry is replaced or discarded, and before
+    /// they are looked at to choose a page to evict.
+    void SyncTlbEntry(const TranslationEntry *entry);
+
+    /// Tag the TLB entries of this address space with an identifier, and
+    /// tell processor `cpu` to match that identifier.
+    ///
+    /// Entries of other address spaces stay in the TLB, so switching
+    /// between processes does not flush it.  Identifiers are handed out
+    /// until they run out; then every TLB is flushed and each address space
+    /// gets a new one the next time it runs.
+    void AssignAsid(unsigned cpu);
+#endif
+
+    /// Name of the executable file the program was loaded from.
+    const char *GetExecutableName() const;
+
+#ifdef SWAP
+    /// Whether page `vpn`, in memory, needs a new slot in the swap partition
+    /// to be evicted: it was modified, and it has no slot nor file to be
+    /// written to.
+    bool NeedsSwapSlot(int vpn) const;
+
+    /// Give page `vpn` a slot in the swap partition, if it has none.  Pages
+    /// of mapped files need none: they are written back to the file.
+    ///
+    /// Returns false if the partition is full.
+    bool ReserveSwapSlot(int vpn);
+
+    /// Write page `vpn`, which is in memory, to its slot, or to its file if
+    /// it is mapped.
+    ///
+    /// Waits for the disk; the page stays mapped meanwhile, so the caller
+    /// clears its dirty bit before and checks it after.
+    void WriteBackPage(int vpn);
+
+    /// Take the clean page `vpn` out of memory.  It is loaded again from
+    /// its slot, or from the executable or its mapped file if it has none.
+    void EvictPage(int vpn);
+
+    /// Page `vpn`, in memory, is about to be used.  If it was loaded ahead
+    /// of a fault, count the prefetch as useful.
+    void CountPrefetchUse(unsigned vpn);
+
+    /// Map `length` bytes of `file`, from position `offset`, to the highest
+    /// free pages below the stack; 0 maps up to the end of the file.
+    ///
+    /// Nothing is read until the pages are used: each one is read from the
+    /// file into its frame on its first fault, and written back to the file
+    /// if it was modified, when it is evicted or unmapped.  The end of the
+    /// last page, past `length` or past the end of the file, reads as zeros
+    /// and is never written back.
+    ///
+    /// `file` must stay open while it is mapped.  The copy that `Fork`
+    /// makes does not have the mappings.
+    ///
+    /// Returns the first page of the mapping, or -1 if `offset` is past the
+    /// end of the file or there is no room left.
+    int Map(OpenFile *file, unsigned offset, unsigned length);
+
+    /// Remove the mapping that starts at page `vpn`, writing back its
+    /// modified pages.
+    ///
+    /// Returns false if no mapping starts there.
+    bool Unmap(unsigned vpn);
+#endif
+
+    /// A write to page `vpn` trapped because the page is read-only.  If it
+    /// is only so because it is shared after a `Fork`, give this address
+    /// space a copy of its own that can be written, or let it write the
+    /// frame if no one else maps it any more.
+    ///
+    /// Returns false if the page is really read-only.  Sets `fullMemory` if
+    /// there is no frame for the copy.
+    bool CopyOnWrite(unsigned vpn);
+
+    /// Write the page table, the frames in use and the pages kept in swap
+    /// to the open host file `fd`, for a checkpoint of the machine.
+    ///
+    /// The contents of the frames themselves are saved with the rest of the
+    /// physical memory.
+    void SaveCheckpoint(int fd);
+
+    /// Take the pages of a checkpoint written by `SaveCheckpoint` for the
+    /// same program, instead of the ones this address space started with.
+    void RestoreCheckpoint(int fd);
+
     bool fullMemory;
 private:
 
-    /// Assume linear page table translation for now!
-    TranslationEntry *pageTable;
+    PageTable *pageTable;
 
     /// Number of pages in the virtual address space.
     unsigned numPages;
+
+    /// Pages of the program, from page 0, of the heap, right after it,
+    /// and of the stack, at the end.
+    unsigned imagePages;
+    unsigned heapPages;
+    unsigned stackPages;
+
     unsigned size;
     uint32_t codeSize;
     uint32_t codeAddrStart;
@@ -72,13 +251,84 @@ private:
     uint32_t initDataAddrEnd;
     Executable *exe;
     OpenFile *executable_file;
-    OpenFile *file_swap;
+#ifdef SWAP
+    /// Sector of the file header of the executable, which names its pages
+    /// in the page cache.
+    unsigned executableSector;
+
+    /// Version of the executable when the space was created: pages cached
+    /// from an older or newer version are not shared.
+    unsigned executableVersion;
+
+    /// A range of pages mapped to a file by `Map`.
+    struct Mapping {
+        unsigned firstVpn;
+        unsigned numPages;
+        OpenFile *file;
+        unsigned offset;  ///< Position in the file of the first page.
+        unsigned length;  ///< Bytes of the file that are mapped.
+        Mapping *next;    ///< The next one down the address space.
+    };
+
+    /// Mapped files, from the highest.
+    Mapping *mappings;
+
+    /// Pages of the program, the heap and the stack counted against the
+    /// frames and swap slots that can hold them, see `CommitPages`.
+    unsigned committed;
+#endif
     int threadPid;
+    char executableName[FILE_NAME_MAX_LEN + 1];
+    Profile *profile;  ///< Shared with the other runs of the executable.
+#ifdef USE_TLB
+    unsigned asid;
+    unsigned asidOwnerGeneration;  ///< Generation `asid` was given in.
+#endif
 
-    int PickVictim();
     void LoadPageFromCode(int vpn, int physical);
+
+    /// Kind of page `vpn`, from the segments of the executable.
+    PageKind KindOf(unsigned vpn) const;
+
+    /// Whether page `vpn` is made entirely of code, and so is read-only.
+    bool IsTextPage(unsigned vpn) const;
+
+    /// Load page `vpn`, of kind `PAGE_ZERO`, into `physical`, which is
+    /// already filled with zeros if `zeroed`.
+    void ZeroFillPage(unsigned vpn, int physical, bool zeroed);
+
+    /// Load `count` consecutive pages from `firstVpn` from the executable
+    /// into `frames`, reading each segment of the file once.
+    void LoadPagesFromCode(unsigned firstVpn, unsigned count,
+                           const int *frames);
+#ifdef SWAP
+    /// Count `count` more pages of this address space against the frames
+    /// and swap slots, so that every page handed out can be kept somewhere.
+    /// Must be called with `usedPagesLock` held.
+    ///
+    /// Returns false, counting nothing, if they would not fit.
+    bool CommitPages(unsigned count);
+
+    /// Which of the code, initialized data, the rest of the program and
+    /// the stack, or a mapped file, page `vpn` starts in.
+    unsigned SegmentOf(unsigned vpn) const;
+
+    /// The mapping page `vpn` belongs to, or null.
+    Mapping *FindMapping(unsigned vpn) const;
+
+    /// Load page `vpn`, of kind `PAGE_MAPPED`, from its file into
+    /// `physical`.
+    void LoadPageFromFile(unsigned vpn, int physical);
+
+    /// Load the pages after `vpn` that fault-around takes: those that are
+    /// in `source` (`NOT_LOAD_ADDR` or `ADDR_IN_SWAP`), as `vpn` was.
+    void FaultAround(unsigned vpn, int source);
+
+    /// Put page `vpn`, just loaded from the executable into `frame`, in
+    /// the page cache if it is a text page not cached yet.
+    void CachePage(unsigned vpn, int frame);
+#endif
 #ifdef SWAP
-    bool StorePageInSWAP(int vpn);
     bool LoadPageFromSWAP(int vpn, int physical);
 #endif
 };
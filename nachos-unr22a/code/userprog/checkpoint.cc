@@ -0,0 +1,285 @@
+/// Routines to save the simulated machine to a host file and resume from it.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "checkpoint.hh"
+#include "address_space.hh"
+#include "exception.hh"
+#include "machine/machine.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static const char CHECKPOINT_MAGIC[8] = {
+    'N', 'A', 'C', 'H', 'O', 'S', 'C', 'K'
+};
+
+/// Unix file that holds the disk of the real file system.
+static const char DISK_NAME[] = "DISK";
+
+/// First thing in a checkpoint: it can only be restored by a Nachos that
+/// simulates the same machine.
+struct CheckpointHeader {
+    char magic[sizeof CHECKPOINT_MAGIC];
+    unsigned pageSize;
+    unsigned numPhysPages;
+    unsigned tlbSize;
+    unsigned numCpus;
+    unsigned statsSize;
+    unsigned diskSize;  ///< Size of the disk image that follows, if any.
+};
+
+static const char *checkpointFile = nullptr;
+static unsigned long checkpointTime;
+
+void
+ScheduleCheckpoint(const char *fileName, unsigned long when)
+{
+    ASSERT(fileName != nullptr);
+
+    checkpointFile = fileName;
+    checkpointTime = when;
+}
+
+static void
+FillHeader(CheckpointHeader *header)
+{
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof header->magic);
+    header->pageSize     = PAGE_SIZE;
+    header->numPhysPages = NUM_PHYS_PAGES;
+    header->tlbSize      = TLB_SIZE;
+    header->numCpus      = stats->numCpus;
+    header->statsSize    = sizeof *stats;
+    header->diskSize     = 0;
+}
+
+/// Copy `size` bytes from the Unix file `from` to the Unix file `to`.
+static void
+CopyHostFile(int from, int to, unsigned size)
+{
+    char buffer[1024];
+    while (size > 0) {
+        unsigned chunk = size < sizeof buffer ? size : sizeof buffer;
+        SystemDep::Read(from, buffer, chunk);
+        SystemDep::WriteFile(to, buffer, chunk);
+        size -= chunk;
+    }
+}
+
+/// The machine can be saved if the current thread is the only one left,
+/// either running or ready to run on any processor, and the program it runs
+/// has no open files.
+static bool
+CanCheckpoint()
+{
+    if (currentThread->space == nullptr) {
+        return false;
+    }
+    // El pid 0 esta reservado, no es de ningun proceso.
+    for (int id = 1; id < (int) Table<Thread*>::SIZE; id++) {
+        if (userThreads->HasKey(id) && userThreads->Get(id) != currentThread) {
+            return false;
+        }
+    }
+    for (unsigned cpu = 0; cpu < scheduler->GetNumCpus(); cpu++) {
+        if (scheduler->HasReadyThreads(cpu)
+              || (cpu != interrupt->GetCpu()
+                    && scheduler->GetCpuThread(cpu) != nullptr)) {
+            return false;
+        }
+    }
+    // Los descriptores 0 y 1 son la consola.
+    for (int id = 2; id < (int) Table<OpenFile*>::SIZE; id++) {
+        if (currentThread->HasOpenFileId(id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+CheckpointIfDue()
+{
+    if (checkpointFile == nullptr || stats->totalTicks < checkpointTime) {
+        return;
+    }
+    if (!CanCheckpoint()) {
+        DEBUG('a', "Machine busy, checkpoint postponed\n");
+        return;
+    }
+
+    AddressSpace *space = currentThread->space;
+    int fd = SystemDep::OpenForWrite(checkpointFile);
+
+    CheckpointHeader header;
+    FillHeader(&header);
+#ifdef FILESYS
+    int disk = SystemDep::OpenForReadWrite(DISK_NAME, true);
+    SystemDep::Lseek(disk, 0, SEEK_END);
+    header.diskSize = SystemDep::Tell(disk);
+    SystemDep::Lseek(disk, 0, SEEK_SET);
+#endif
+    SystemDep::WriteFile(fd, (char *) &header, sizeof header);
+#ifdef FILESYS
+    CopyHostFile(disk, fd, header.diskSize);
+    SystemDep::Close(disk);
+#endif
+
+    char name[FILE_NAME_MAX_LEN + 1];
+    memset(name, 0, sizeof name);
+    strncpy(name, space->GetExecutableName(), FILE_NAME_MAX_LEN);
+    SystemDep::WriteFile(fd, name, sizeof name);
+    SystemDep::WriteFile(fd, (char *) &currentThread->pid,
+                         sizeof currentThread->pid);
+    bool console = SynchConsoleInUse();
+    SystemDep::WriteFile(fd, (char *) &console, sizeof console);
+
+    SystemDep::WriteFile(fd, (char *) &currentThread->currentDirectory,
+                         sizeof currentThread->currentDirectory);
+    space->SaveCheckpoint(fd);
+
+    int registers[NUM_TOTAL_REGS];
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        registers[i] = machine->ReadRegister(i);
+    }
+    SystemDep::WriteFile(fd, (char *) registers, sizeof registers);
+    MMU *mmu = machine->GetMMU();
+    SystemDep::WriteFile(fd, mmu->mainMemory, NUM_PHYS_PAGES * PAGE_SIZE);
+#ifdef USE_TLB
+    // Solo las entradas del programa guardado; al restaurar tendra otro ASID.
+    TranslationEntry *tlb = new TranslationEntry [TLB_SIZE];
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        tlb[i] = mmu->tlb[i];
+        tlb[i].valid = tlb[i].valid && tlb[i].asid == mmu->GetAsid();
+    }
+    SystemDep::WriteFile(fd, (char *) tlb, TLB_SIZE * sizeof *tlb);
+    delete [] tlb;
+#endif
+    interrupt->SaveCheckpoint(fd);
+    // Al restaurar se vuelve a buscar la instruccion de la llamada.
+    Statistics saved = *stats;
+    saved.TLBTotals--;
+    SystemDep::WriteFile(fd, (char *) &saved, sizeof saved);
+    SystemDep::Close(fd);
+
+    DEBUG('a', "Checkpoint of %s written to %s at time %lu\n",
+          name, checkpointFile, stats->totalTicks);
+    checkpointFile = nullptr;
+}
+
+/// Open the checkpoint `fileName` and read its header.
+///
+/// Returns the Unix file descriptor, or -1 if it cannot be restored.
+static int
+OpenCheckpoint(const char *fileName, CheckpointHeader *header)
+{
+    ASSERT(fileName != nullptr);
+    ASSERT(header != nullptr);
+
+    int fd = SystemDep::OpenForReadWrite(fileName, false);
+    if (fd < 0) {
+        printf("Unable to open checkpoint %s\n", fileName);
+        return -1;
+    }
+
+    CheckpointHeader expected;
+    FillHeader(&expected);
+    SystemDep::Read(fd, (char *) header, sizeof *header);
+    expected.diskSize = header->diskSize;
+    if (memcmp(header, &expected, sizeof expected) != 0) {
+        printf("Checkpoint %s was taken on a different machine\n", fileName);
+        SystemDep::Close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void
+RestoreCheckpointDisk(const char *fileName)
+{
+    CheckpointHeader header;
+    int fd = OpenCheckpoint(fileName, &header);
+    if (fd < 0) {
+        return;
+    }
+    if (header.diskSize > 0) {
+        int disk = SystemDep::OpenForWrite(DISK_NAME);
+        CopyHostFile(fd, disk, header.diskSize);
+        SystemDep::Close(disk);
+    }
+    SystemDep::Close(fd);
+}
+
+void
+RestoreCheckpoint(const char *fileName)
+{
+    CheckpointHeader header;
+    int fd = OpenCheckpoint(fileName, &header);
+    if (fd < 0) {
+        return;
+    }
+    SystemDep::Lseek(fd, sizeof header + header.diskSize, SEEK_SET);
+
+    char name[FILE_NAME_MAX_LEN + 1];
+    int savedPid;
+    SystemDep::Read(fd, name, sizeof name);
+    SystemDep::Read(fd, (char *) &savedPid, sizeof savedPid);
+    OpenFile *executable = fileSystem->Open(name);
+    if (executable == nullptr) {
+        printf("Unable to open file %s\n", name);
+        SystemDep::Close(fd);
+        return;
+    }
+
+    int pid = userThreads->Add(currentThread);
+    currentThread->pid = pid;
+    AddressSpace *space = new AddressSpace(executable, pid, name);
+    currentThread->space = space;
+
+    // Los dispositivos tienen que existir para recuperar sus interrupciones.
+    bool console;
+    SystemDep::Read(fd, (char *) &console, sizeof console);
+    if (console) {
+        InitSynchConsole();
+    }
+    SystemDep::Read(fd, (char *) &currentThread->currentDirectory,
+                    sizeof currentThread->currentDirectory);
+    space->RestoreCheckpoint(fd);
+    space->RestoreState();
+
+    int registers[NUM_TOTAL_REGS];
+    SystemDep::Read(fd, (char *) registers, sizeof registers);
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, registers[i]);
+    }
+    MMU *mmu = machine->GetMMU();
+    SystemDep::Read(fd, mmu->mainMemory, NUM_PHYS_PAGES * PAGE_SIZE);
+#ifdef USE_TLB
+    SystemDep::Read(fd, (char *) mmu->tlb, TLB_SIZE * sizeof *mmu->tlb);
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        mmu->tlb[i].asid = mmu->GetAsid();
+    }
+#endif
+    // Last, so that restoring does not take simulated time.
+    interrupt->RestoreCheckpoint(fd);
+    const char *tlbPolicyName = stats->TLBPolicy;  // Point into this run.
+    const char *pagePolicyName = stats->pagePolicy;
+    SystemDep::Read(fd, (char *) stats, sizeof *stats);
+    stats->TLBPolicy = tlbPolicyName;
+    stats->pagePolicy = pagePolicyName;
+    for (unsigned frame = 0; frame < NUM_PHYS_PAGES; frame++) {
+        mmu->InvalidateDecodedFrame(frame);
+    }
+    mmu->InvalidateTranslationCache();
+    SystemDep::Close(fd);
+
+    DEBUG('a', "Restored %s from checkpoint %s at time %lu\n",
+          name, fileName, stats->totalTicks);
+    machine->Run();  // Jump to the user progam.
+    ASSERT(false);
+}
@@ -0,0 +1,44 @@
+/// Checkpoint and restore of the simulated machine.
+///
+/// A checkpoint is a host file with everything needed to resume a user
+/// program later, without going again through what led it there: physical
+/// memory, registers, TLB, the page table, the frames in use (coremap),
+/// the pending interrupts, the statistics and, with the real file system,
+/// the image of the disk.
+///
+/// Kernel threads run on host stacks that cannot be saved, so the machine
+/// is only saved when a single user program is left, it enters the kernel
+/// through a system call, and it has no files open; those are also the only
+/// conditions under which no device has a request in flight.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_CHECKPOINT__HH
+#define NACHOS_USERPROG_CHECKPOINT__HH
+
+
+/// Arrange for the machine to be saved to the host file `fileName` at the
+/// first system call made once simulated time reaches `when`.
+void ScheduleCheckpoint(const char *fileName, unsigned long when);
+
+/// Save the machine now if a checkpoint was scheduled, it is due and the
+/// machine can be saved.
+///
+/// Called on entry to the kernel from a system call, when the program
+/// counter still points to it: the restored program makes the call again.
+void CheckpointIfDue();
+
+/// Put back the disk image saved in the checkpoint `fileName`.
+///
+/// Must be done before the disk is opened.
+void RestoreCheckpointDisk(const char *fileName);
+
+/// Resume the user program saved in the checkpoint `fileName`.
+///
+/// Does not return unless the checkpoint cannot be used.
+void RestoreCheckpoint(const char *fileName);
+
+
+#endif
@@ -33,6 +33,8 @@
 #include "args.hh"
 #include "synch_console.hh"
 #include "machine.hh"
+#include "exception.hh"
+#include "checkpoint.hh"
 static SynchConsole *synchConsole = nullptr;
 
 #include <stdio.h>
@@ -45,6 +47,10 @@ void InitSynchConsole() {
     };
 }
 
+bool SynchConsoleInUse() {
+    return synchConsole != nullptr;
+}
+
 static void
 IncrementPC()
 {
@@ -76,6 +82,19 @@ DefaultHandler(ExceptionType et)
     ASSERT(false);
 }
 
+/// Finish the current user program with `status`, releasing its memory.
+static void
+ExitProcess(int status)
+{
+    userThreads->Remove(currentThread->pid);
+    // La memoria se libera ahora: el thread puede quedar esperando a que lo junten, y liberarla puede
+    // bloquearlo, cosa que no puede pasar cuando se destruye.
+    delete currentThread->space;
+    currentThread->space = nullptr;
+    currentThread->Finish(status); // Esto pone al thread como threadToBeDestroyed, lo cual el scheduler llama a ~Thread, lo cual libera el stack.
+    ASSERT(false);
+}
+
 void
 RunProgram(void *argsParentThread)
 {
@@ -108,6 +127,22 @@ RunProgram(void *argsParentThread)
     machine->Run();
 }
 
+/// Run the child of a `Fork`.  It goes on from the call with the registers
+/// the parent had then, saved in `registers`, except that `Fork` returns 0
+/// to it.
+static void
+RunForkedProcess(void *registers)
+{
+    int *saved = (int *) registers;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, saved[i]);
+    }
+    delete [] saved;
+    currentThread->space->RestoreState();
+
+    machine->Run();
+}
+
 /// Handle a system call exception.
 ///
 /// * `et` is the kind of exception.  The list of possible exceptions is in
@@ -129,6 +164,9 @@ SyscallHandler(ExceptionType _et)
 {
     int scid = machine->ReadRegister(2);
 
+    // El PC todavia apunta a la llamada, si se guarda la maquina aca al restaurarla se vuelve a hacer.
+    CheckpointIfDue();
+
     switch (scid) {
 
         case SC_HALT:
@@ -197,10 +235,7 @@ SyscallHandler(ExceptionType _et)
         case SC_EXIT: {
             int status = machine->ReadRegister(4);
             DEBUG('e', "`Exit` requested with code %d.\n", status);
-
-            userThreads->Remove(currentThread->pid);
-            currentThread->Finish(status); // Esto pone al thread como threadToBeDestroyed, lo cual el scheduler llama a ~Thread, lo cual libera el stack.
-            ASSERT(false);
+            ExitProcess(status);
         }
 
         case SC_READ: {
@@ -467,17 +502,21 @@ SyscallHandler(ExceptionType _et)
             DEBUG('t', "PID: %d\n", pid);
             if (pid == -1){
                 DEBUG('e', "Error: Too many processes.\n");
+                userThreadsLock->Release();
                 machine->WriteRegister(2, -1);
+                delete openFile;
                 delete thread;
                 break;
             }
 
             thread->pid = pid;
-            AddressSpace *addrSpc = new AddressSpace(openFile, pid); //Puede ser que falle si no hay mas memoria fisica.
+            AddressSpace *addrSpc = new AddressSpace(openFile, pid, filename); //Puede ser que falle si no hay mas memoria fisica.
             if (addrSpc->fullMemory) {
                 DEBUG('e', "Error: Insufficient memory size for address space.\n");
+                userThreads->Remove(pid);
+                userThreadsLock->Release();
                 machine->WriteRegister(2, -1);
-                delete addrSpc; // Puede no ser necesario
+                delete addrSpc;  // Cierra tambien el ejecutable.
                 delete thread;
                 break;
             }
@@ -496,12 +535,141 @@ SyscallHandler(ExceptionType _et)
             break;
         }
 
+        case SC_FORK: {
+            // SpaceId Fork(bool joinable);
+            DEBUG('e', "`Fork` requested.\n");
+            bool joinable = machine->ReadRegister(4);
+
+            // El hijo carga del ejecutable las paginas que el padre no cargo todavia, necesita abrirlo de nuevo.
+            AddressSpace *parent = currentThread->space;
+            OpenFile *openFile = fileSystem->Open(parent->GetExecutableName());
+            if (!openFile) {
+                DEBUG('e', "Error: cannot open executable %s again.\n", parent->GetExecutableName());
+                machine->WriteRegister(2, -1);
+                break;
+            }
+
+            Thread *thread = new Thread(currentThread->GetName(), joinable, 0);
+            userThreadsLock->Acquire();
+            int pid = userThreads->Add(thread);
+            userThreadsLock->Release();
+            if (pid == -1) {
+                DEBUG('e', "Error: Too many processes.\n");
+                machine->WriteRegister(2, -1);
+                delete openFile;
+                delete thread;
+                break;
+            }
+
+            thread->pid = pid;
+            AddressSpace *addrSpc = new AddressSpace(parent, openFile, pid);
+            if (addrSpc->fullMemory) {
+                DEBUG('e', "Error: Insufficient memory size for address space.\n");
+                machine->WriteRegister(2, -1);
+                userThreadsLock->Acquire();
+                userThreads->Remove(pid);
+                userThreadsLock->Release();
+                delete addrSpc;
+                delete thread;
+                break;
+            }
+            thread->space = addrSpc;
+            thread->currentDirectory = currentThread->currentDirectory;
+
+            // Los registros del padre en la llamada, con el PC ya avanzado como se hace al volver de ella.
+            int *registers = new int [NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+                registers[i] = machine->ReadRegister(i);
+            }
+            registers[2] = 0;
+            registers[PREV_PC_REG] = registers[PC_REG];
+            registers[PC_REG] = registers[NEXT_PC_REG];
+            registers[NEXT_PC_REG] += 4;
+            thread->Fork(&RunForkedProcess, (void *) registers);
+            DEBUG('e', "Forked process %d\n", pid);
+            machine->WriteRegister(2, pid);
+            break;
+        }
+
         case SC_PS: {
             DEBUG('e', "`Ps` requested.\n");
             scheduler->Print(); // No se que tan correcto es esto
             break;
         }
 
+        case SC_MMAP: {
+            // void *Mmap(OpenFileId id, int offset, int length);
+            OpenFileId fileId = machine->ReadRegister(4);
+            int offset = machine->ReadRegister(5);
+            int length = machine->ReadRegister(6);
+            DEBUG('e', "`Mmap` requested for id %d, offset %d, length %d.\n", fileId, offset, length);
+#ifndef SWAP
+            // Sin memoria virtual no hay donde escribir las paginas modificadas, mas que en el archivo: no se mapea.
+            DEBUG('e', "Error: no virtual memory to map files.\n");
+            machine->WriteRegister(2, 0);
+#else
+            if (fileId == CONSOLE_INPUT || fileId == CONSOLE_OUTPUT || !currentThread->HasOpenFileId(fileId)) {
+                DEBUG('e', "Error: Not exists open file with the given file id.\n");
+                machine->WriteRegister(2, 0);
+                break;
+            }
+            if (offset < 0) {
+                DEBUG('e', "Error: offset is negative.\n");
+                machine->WriteRegister(2, 0);
+                break;
+            }
+            if (length < 0) {
+                DEBUG('e', "Error: length is negative.\n");
+                machine->WriteRegister(2, 0);
+                break;
+            }
+            int vpn = currentThread->space->Map(currentThread->GetOpenFile(fileId), offset, length);
+            if (vpn == -1) {
+                DEBUG('e', "Error: cannot map the file.\n");
+                machine->WriteRegister(2, 0);
+                break;
+            }
+            machine->WriteRegister(2, vpn * PAGE_SIZE);
+#endif
+            break;
+        }
+
+        case SC_MUNMAP: {
+            // int Munmap(void *addr);
+            int addr = machine->ReadRegister(4);
+            DEBUG('e', "`Munmap` requested for address %d.\n", addr);
+#ifndef SWAP
+            machine->WriteRegister(2, -1);
+#else
+            if (addr <= 0 || addr % PAGE_SIZE != 0 || !currentThread->space->Unmap(addr / PAGE_SIZE)) {
+                DEBUG('e', "Error: no mapping starts at the given address.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            machine->WriteRegister(2, 0);
+#endif
+            break;
+        }
+
+        case SC_SBRK: {
+            // void *Sbrk(int increment);
+            int increment = machine->ReadRegister(4);
+            DEBUG('e', "`Sbrk` requested for %d bytes.\n", increment);
+            if (increment < 0) {
+                DEBUG('e', "Error: the heap cannot shrink.\n");
+                machine->WriteRegister(2, 0);
+                break;
+            }
+            int vpn = currentThread->space->GrowHeap(DivRoundUp((unsigned) increment, PAGE_SIZE));
+            if (vpn == -1) {
+                DEBUG('e', "Error: cannot grow the heap.\n");
+                machine->WriteRegister(2, 0);
+                break;
+            }
+            machine->WriteRegister(2, vpn * PAGE_SIZE);
+            break;
+        }
+
         default:
             fprintf(stderr, "Unexpected system call: id %d.\n", scid);
             ASSERT(false);
@@ -516,9 +684,6 @@ unsigned int getVPN (int vaddr)
     return (unsigned) vaddr / PAGE_SIZE;
 }
 
-// indice para la FIFO de la TLB
-static unsigned int iTLB = 0;
-
 static void
 PageFaultHandler(ExceptionType _et) {
 
@@ -531,34 +696,89 @@ PageFaultHandler(ExceptionType _et) {
 	int vaddr = machine->ReadRegister(BAD_VADDR_REG);
 	unsigned int vpn = getVPN(vaddr); // sacarle el tamaño del desplazamiento.
 
+    // La instruccion que fallo se vuelve a ejecutar, el PC todavia la apunta.
+    Profile *profile = machine->GetProfile();
+    unsigned pc = machine->ReadRegister(PC_REG);
+    if (profile != nullptr) {
+        profile->CountTlbMiss(pc);
+    }
+
+    // Fuera del programa, del stack y de los archivos mapeados no hay pagina que cargar.
+    PageTable *pageTable = currentThread->space->GetPageTable();
+    if (!currentThread->space->IsValidPage(vpn)) {
+        DefaultHandler(ADDRESS_ERROR_EXCEPTION);
+    }
+
 	// para saber cual i hago FIFO
     // Solo es necesario cargar paginas si hay DEMAND_LOADING TODO con bandera SWAP hay que ver si physicalPage es -2 tambien. Ver que hacer con load page si no se puede cargar (solo con DEMAND_LOADING sin SWAP).
 #ifdef DEMAND_LOADING
 #ifdef SWAP
-    if (currentThread->space->GetPageTable()[vpn].physicalPage == -1 || currentThread->space->GetPageTable()[vpn].physicalPage == -2) {
-        DEBUG('p', "Must be -1: %d\n", currentThread->space->GetPageTable()[vpn].physicalPage);
+    // Una pagina sin entrada en la tabla nunca se cargo.
+    const PageTableEntry *loaded = pageTable->Find(vpn);
+    if (loaded == nullptr || loaded->translation.physicalPage < 0) {
+        DEBUG('p', "Page %u not in memory\n", vpn);
         currentThread->space->LoadPage(vpn);
+        stats->numPageFaults++;
+        if (profile != nullptr) {
+            profile->CountPageFault(pc);
+        }
+        if (currentThread->space->fullMemory) {
+            DEBUG('p', "No memory nor swap left for page %u, exiting process\n", vpn);
+            ExitProcess(-1);
+        }
+        // Al soltar el lock de los marcos pudo correr el daemon y desalojarla otra vez: la instruccion se vuelve
+        // a ejecutar y falla de nuevo.
+        loaded = pageTable->Find(vpn);
+        if (loaded == nullptr || loaded->translation.physicalPage < 0) {
+            return;
+        }
+    } else {
+        currentThread->space->CountPrefetchUse(vpn);
     }
 #else
     // Si no hay swap, como se hizo en EXEC es necesario que algun programa finalice su ejecucion. Esto lo realiza el que no puede cargar su proxima pagina.
-    if (currentThread->space->GetPageTable()[vpn].physicalPage == -1) {
-        DEBUG('p', "Must be -1: %d\n", currentThread->space->GetPageTable()[vpn].physicalPage);
+    const PageTableEntry *loaded = pageTable->Find(vpn);
+    if (loaded == nullptr || loaded->translation.physicalPage == -1) {
+        DEBUG('p', "Page %u not in memory\n", vpn);
         currentThread->space->LoadPage(vpn);
+        stats->numPageFaults++;
+        if (profile != nullptr) {
+            profile->CountPageFault(pc);
+        }
         if (currentThread->space->fullMemory) {
             DEBUG('p', "Memory full, can't load page, exiting process\n");
-            currentThread->Finish(-1);
+            ExitProcess(-1);
         }
     }
 #endif
 #endif
-    DEBUG('p', "Physical page addr: %d\n", currentThread->space->GetPageTable()[vpn].physicalPage);
-	machine->GetMMU()->tlb[iTLB++%TLB_SIZE] = currentThread->space->GetPageTable()[vpn];
+    const TranslationEntry *page = &pageTable->Find(vpn)->translation;
+    DEBUG('p', "Physical page addr: %d\n", page->physicalPage);
+    // La entrada a reemplazar la elige la politica de la TLB. Antes se copian los bits de uso y modificacion a la
+    // tabla de paginacion: la politica puede limpiar los de uso, y los de la entrada reemplazada se pierden.
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+#ifdef USE_TLB
+    SyncTlbBits(tlb);
+#endif
+    unsigned entry = tlbPolicy->PickVictim(interrupt->GetCpu(), tlb);
+    tlb[entry] = *page;
+    tlb[entry].asid = machine->GetMMU()->GetAsid();
+	machine->GetMMU()->InvalidateTranslationCache();
 }
 
-// TODO Check this
+// Las paginas compartidas despues de un Fork son de solo lectura hasta que alguno las escribe; entonces se copian
+// y se vuelve a ejecutar la instruccion.
 static void ReadOnlyHandler(ExceptionType _et)
 {
-    DEBUG('e', "Tried to read from a read only page");
+    int vaddr = machine->ReadRegister(BAD_VADDR_REG);
+    if (currentThread->space->CopyOnWrite(getVPN(vaddr))) {
+        if (currentThread->space->fullMemory) {
+            DEBUG('p', "No memory nor swap left for a copy, exiting process\n");
+            ExitProcess(-1);
+        }
+        return;
+    }
+    DEBUG('e', "Tried to write to a read only page");
 
     ASSERT(false);
     return;
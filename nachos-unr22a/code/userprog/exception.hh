@@ -13,5 +13,12 @@
 /// call, or generates an addressing or arithmetic exception.
 void SetExceptionHandlers();
 
+/// Create the console used by the `Read` and `Write` system calls, if
+/// user programs have not done so yet.
+void InitSynchConsole();
+
+/// Whether user programs have already used the console.
+bool SynchConsoleInUse();
+
 
 #endif
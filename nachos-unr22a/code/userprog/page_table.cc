@@ -0,0 +1,166 @@
+/// Routines to manage the page table of an address space.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_table.hh"
+#include "lib/utility.hh"
+
+
+/// Buckets of an empty table.
+static const unsigned INITIAL_BUCKETS = 8;
+
+PageTable::PageTable(unsigned n)
+{
+    numPages = n;
+    numEntries = 0;
+    numBuckets = INITIAL_BUCKETS;
+    buckets = new PageTableEntry *[numBuckets];
+    for (unsigned i = 0; i < numBuckets; i++) {
+        buckets[i] = nullptr;
+    }
+}
+
+PageTable::~PageTable()
+{
+    for (unsigned i = 0; i < numBuckets; i++) {
+        while (buckets[i] != nullptr) {
+            PageTableEntry *entry = buckets[i];
+            buckets[i] = entry->next;
+            delete entry;
+        }
+    }
+    delete [] buckets;
+}
+
+unsigned
+PageTable::GetNumPages() const
+{
+    return numPages;
+}
+
+unsigned
+PageTable::Hash(unsigned vpn) const
+{
+    // Consecutive pages, the common case, go to consecutive buckets.
+    return vpn & (numBuckets - 1);
+}
+
+PageTableEntry *
+PageTable::Find(unsigned vpn) const
+{
+    for (PageTableEntry *entry = buckets[Hash(vpn)]; entry != nullptr;
+         entry = entry->next) {
+        if (entry->translation.virtualPage == vpn) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+PageTableEntry *
+PageTable::Enter(unsigned vpn)
+{
+    ASSERT(vpn < numPages);
+
+    PageTableEntry *entry = Find(vpn);
+    if (entry != nullptr) {
+        return entry;
+    }
+    if (numEntries == numBuckets) {
+        Grow();
+    }
+
+    entry = new PageTableEntry;
+    entry->translation.virtualPage  = vpn;
+    entry->translation.physicalPage = -1;
+    entry->translation.valid        = false;
+    entry->translation.readOnly     = false;
+    entry->translation.use          = false;
+    entry->translation.dirty        = false;
+    entry->translation.asid         = 0;
+#ifdef SWAP
+    entry->swapSlot    = -1;
+    entry->prefetched  = false;
+    entry->copyOnWrite = false;
+#endif
+    unsigned bucket = Hash(vpn);
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+    numEntries++;
+    return entry;
+}
+
+void
+PageTable::Remove(unsigned vpn)
+{
+    for (PageTableEntry **link = &buckets[Hash(vpn)]; *link != nullptr;
+         link = &(*link)->next) {
+        if ((*link)->translation.virtualPage == vpn) {
+            PageTableEntry *entry = *link;
+            *link = entry->next;
+            delete entry;
+            numEntries--;
+            return;
+        }
+    }
+}
+
+unsigned
+PageTable::CountEntries() const
+{
+    return numEntries;
+}
+
+void
+PageTable::Grow()
+{
+    // The entries are moved, not copied: pointers to them stay good.
+    PageTableEntry **old = buckets;
+    unsigned oldBuckets = numBuckets;
+    numBuckets *= 2;
+    buckets = new PageTableEntry *[numBuckets];
+    for (unsigned i = 0; i < numBuckets; i++) {
+        buckets[i] = nullptr;
+    }
+    for (unsigned i = 0; i < oldBuckets; i++) {
+        while (old[i] != nullptr) {
+            PageTableEntry *entry = old[i];
+            old[i] = entry->next;
+            unsigned bucket = Hash(entry->translation.virtualPage);
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+        }
+    }
+    delete [] old;
+}
+
+PageTableEntry *
+PageTable::First() const
+{
+    for (unsigned i = 0; i < numBuckets; i++) {
+        if (buckets[i] != nullptr) {
+            return buckets[i];
+        }
+    }
+    return nullptr;
+}
+
+PageTableEntry *
+PageTable::Next(const PageTableEntry *entry) const
+{
+    ASSERT(entry != nullptr);
+
+    if (entry->next != nullptr) {
+        return entry->next;
+    }
+    for (unsigned i = Hash(entry->translation.virtualPage) + 1;
+         i < numBuckets; i++) {
+        if (buckets[i] != nullptr) {
+            return buckets[i];
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,112 @@
+/// Data structures for the page table of an address space.
+///
+/// The page table is hashed: it only has entries for the pages that were
+/// ever loaded and not dropped since, chained from a table of buckets by
+/// their virtual page number.  A page without an entry is not in memory and
+/// has nothing but its initial contents, so an address space costs memory
+/// in proportion to the pages it uses, not to the span of its addresses,
+/// and the pages it never touches may be scattered over any part of it.
+///
+/// Besides the translation that the MMU uses, each entry keeps what the
+/// kernel needs to know about the page, as the bits that real page table
+/// entries leave to the software.
+///
+/// Without a TLB, the MMU looks the translations up here directly; with
+/// one, the kernel loads them into the TLB on a miss.
+///
+/// The table is not protected here: callers keep each other out with
+/// `usedPagesLock`, as they do for the coremap.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_PAGETABLE__HH
+#define NACHOS_USERPROG_PAGETABLE__HH
+
+
+#include "machine/translation_entry.hh"
+
+
+class PageTableEntry {
+public:
+
+    /// `physicalPage` is -1 while the page is not in memory and was never
+    /// written anywhere else; then it is loaded with its initial contents.
+    TranslationEntry translation;
+
+#ifdef SWAP
+    /// Slot of the page in the swap partition, -1 if it was never written
+    /// to swap.
+    ///
+    /// Together with the translation this tells where the copy of a page
+    /// is: loaded and clean comes from the executable if it has no slot; in
+    /// swap, or loaded and clean, is in its slot; loaded and dirty is only
+    /// in memory.  Only dirty pages are written on eviction, and a clean
+    /// page with no slot loses its entry.
+    int swapSlot;
+
+    /// Whether the page was loaded ahead of a fault and not used yet.
+    bool prefetched;
+
+    /// Whether the page is read-only only because its frame is shared with
+    /// other address spaces, until it is written.
+    bool copyOnWrite;
+#endif
+
+private:
+    friend class PageTable;
+
+    PageTableEntry *next;  ///< Next entry in the same bucket.
+};
+
+class PageTable {
+public:
+
+    /// Initialize an empty table for an address space of `numPages` pages.
+    PageTable(unsigned numPages);
+
+    ~PageTable();
+
+    /// Number of pages in the address space; virtual pages from there on
+    /// are not part of it.
+    unsigned GetNumPages() const;
+
+    /// Return the entry of page `vpn`, or null if it has none.
+    PageTableEntry *Find(unsigned vpn) const;
+
+    /// Return the entry of page `vpn`, creating it if it has none.
+    ///
+    /// A new entry is invalid, with no frame (-1) and no slot in swap.
+    PageTableEntry *Enter(unsigned vpn);
+
+    /// Drop the entry of page `vpn`, if it has one.
+    void Remove(unsigned vpn);
+
+    /// Number of entries in the table.
+    unsigned CountEntries() const;
+
+    /// Iterate over the entries, in no particular order:
+    ///
+    ///     for (PageTableEntry *e = table->First(); e != nullptr;
+    ///          e = table->Next(e))
+    ///
+    /// Entries may not be entered or removed meanwhile.
+    PageTableEntry *First() const;
+    PageTableEntry *Next(const PageTableEntry *entry) const;
+
+private:
+
+    unsigned Hash(unsigned vpn) const;
+
+    /// Double the number of buckets, when the chains get long.
+    void Grow();
+
+    PageTableEntry **buckets;
+    unsigned numBuckets;  ///< Always a power of two.
+    unsigned numEntries;
+    unsigned numPages;
+};
+
+
+#endif
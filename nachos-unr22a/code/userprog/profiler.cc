@@ -0,0 +1,103 @@
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "profiler.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/// Suffix of the symbol map of an executable.
+static const char SYMBOLS_SUFFIX[] = ".sym";
+
+Profiler::Profiler()
+{
+    profiles = new List<Profile *>;
+    numProfiles = 0;
+}
+
+Profiler::~Profiler()
+{
+    while (!profiles->IsEmpty()) {
+        delete profiles->Pop();
+    }
+    delete profiles;
+}
+
+/// Add to `profile` the symbols in the map of `programName`, if there is
+/// one.
+static void
+LoadSymbols(Profile *profile, const char *programName)
+{
+    ASSERT(profile != nullptr);
+    ASSERT(programName != nullptr);
+
+    char *mapName = new char [strlen(programName) + sizeof SYMBOLS_SUFFIX];
+    strcpy(mapName, programName);
+    strcat(mapName, SYMBOLS_SUFFIX);
+    int map = SystemDep::OpenForReadWrite(mapName, false);
+    if (map < 0) {
+        DEBUG('a', "No symbol map %s, profile will show addresses only\n",
+              mapName);
+        delete [] mapName;
+        return;
+    }
+
+    SystemDep::Lseek(map, 0, SEEK_END);
+    unsigned length = SystemDep::Tell(map);
+    SystemDep::Lseek(map, 0, SEEK_SET);
+    char *text = new char [length + 1];
+    if (length > 0) {
+        SystemDep::Read(map, text, length);
+    }
+    text[length] = '\0';
+    for (char *line = strtok(text, "\n"); line != nullptr;
+           line = strtok(nullptr, "\n")) {
+        unsigned address;
+        char name[64];  // Longer names are cut short.
+        if (sscanf(line, "%x %63s", &address, name) == 2) {
+            profile->AddSymbol(address, name);
+        }
+    }
+
+    delete [] text;
+    SystemDep::Close(map);
+    delete [] mapName;
+}
+
+Profile *
+Profiler::GetProfile(const char *programName)
+{
+    ASSERT(programName != nullptr);
+
+    Profile *found = nullptr;
+    for (unsigned i = 0; i < numProfiles; i++) {
+        Profile *p = profiles->Pop();
+        if (strcmp(p->GetName(), programName) == 0) {
+            found = p;
+        }
+        profiles->Append(p);
+    }
+    if (found == nullptr) {
+        found = new Profile(programName);
+        profiles->Append(found);
+        numProfiles++;
+    }
+    return found;
+}
+
+static void
+PrintProfile(Profile *p)
+{
+    LoadSymbols(p, p->GetName());
+    p->Print();
+}
+
+void
+Profiler::Print()
+{
+    profiles->Apply(PrintProfile);
+}
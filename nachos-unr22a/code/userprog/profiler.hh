@@ -0,0 +1,45 @@
+/// Profiles of the user programs run.
+///
+/// With the `-pf` option, every program gets a profile (see
+/// `machine/profile.hh`), shared by all the processes that run it, and
+/// they are printed when the machine halts.
+///
+/// Functions are named after the symbol map that `coff2noff` writes next
+/// to each executable: `<executable>.sym`, a text file with the address and
+/// name of a procedure on each line.  Without it, only addresses are shown.
+/// Maps are read from the host when printing, not through the file system:
+/// a profiled run must do exactly the same as an unprofiled one, so that
+/// a replayed trace can be profiled.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_PROFILER__HH
+#define NACHOS_USERPROG_PROFILER__HH
+
+
+#include "lib/list.hh"
+#include "machine/profile.hh"
+
+
+class Profiler {
+public:
+    Profiler();
+
+    ~Profiler();
+
+    /// Profile of the executable `programName`, created the first time it
+    /// is asked for.
+    Profile *GetProfile(const char *programName);
+
+    /// Load the symbols of every profile and print it.
+    void Print();
+
+private:
+    List<Profile *> *profiles;  ///< In the order programs were started.
+    unsigned numProfiles;
+};
+
+
+#endif
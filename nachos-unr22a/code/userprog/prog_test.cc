@@ -34,7 +34,7 @@ StartProcess(const char *filename)
     int pid = userThreads->Add(currentThread);
     currentThread->pid = pid;
 
-    AddressSpace *space = new AddressSpace(executable, pid);
+    AddressSpace *space = new AddressSpace(executable, pid, filename);
     currentThread->space = space;
 
     // delete executable;
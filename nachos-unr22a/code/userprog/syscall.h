@@ -32,6 +32,9 @@
 #define SC_READ    14
 #define SC_WRITE   15
 #define SC_PS      16
+#define SC_MMAP    17
+#define SC_MUNMAP  18
+#define SC_SBRK    19
 
 
 #ifndef IN_ASM
@@ -49,7 +52,7 @@
 void Halt();
 
 
-/// Address space control operations: `Exit`, `Exec`, and `Join`.
+/// Address space control operations: `Exit`, `Exec`, `Fork`, and `Join`.
 
 /// This user program is done (`status = 0` means exited normally).
 void Exit(int status);
@@ -66,13 +69,19 @@ SpaceId Exec(char *name, char **argv, bool joineable);
 /// Return the exit status.
 int Join(SpaceId id);
 
+/// Start a copy of the current user program, in an address space of its
+/// own, that goes on from this call with the same memory and registers.
+/// The copy only has the console open, and none of the files mapped with
+/// `Mmap`.  As with `Exec`, it can be joined if `joineable` is true, and
+/// then it does not finish until it is.
+///
+/// Return the address space identifier of the copy to the current program,
+/// 0 to the copy, or -1 if it cannot be started.  No program is ever given
+/// the identifier 0.
+SpaceId Fork(bool joineable);
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
 
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
-int Fork(void (*func)(void));
+/// User-level thread operations: `Yield`.
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
@@ -123,6 +132,42 @@ int Read(char *buffer, int size, OpenFileId id);
 /// Close the file, we are done reading and writing to it.
 int Close(OpenFileId id);
 
+/// Map `length` bytes of the open file `id`, from position `offset`, into
+/// the address space; if `length` is 0, up to the end of the file.
+///
+/// Pages are read from the file when they are first used, and the ones
+/// that are modified are written back to it, when the kernel needs their
+/// memory or on `Munmap`.  The file cannot grow through a mapping: the end
+/// of the last page, past the mapped bytes, reads as zeros and is not
+/// written.  The file must stay open while it is mapped.
+///
+/// Return the address of the first mapped byte, or 0 if `offset` or
+/// `length` is negative or the file cannot be mapped (or the kernel has no
+/// virtual memory).
+void *Mmap(OpenFileId id, int offset, int length);
+
+/// Remove the mapping that starts at `addr`, a value returned by `Mmap`,
+/// writing back its modified pages.  Mappings left at `Exit` are removed
+/// the same way.
+///
+/// Return 0, or -1 if no mapping starts at `addr`.
+int Munmap(void *addr);
+
+
+/// Memory allocation: `Sbrk`.
+
+/// Grow the heap, which starts right after the program, by `increment`
+/// bytes, rounded up to whole pages.  The new memory reads as zeros.  With
+/// demand loading each page takes a frame only once it is used, otherwise
+/// all of them take one right away.  An `increment` of 0 does not grow the
+/// heap.
+///
+/// Return the address where the new memory starts (the end of the heap
+/// before the call), or 0 if `increment` is negative or the heap cannot
+/// grow that much: it would reach a mapped file or the stack, or there is
+/// no memory to back it.
+void *Sbrk(int increment);
+
 void Ps();
 
 
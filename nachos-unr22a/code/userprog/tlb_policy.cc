@@ -0,0 +1,149 @@
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "tlb_policy.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+static const char *const POLICY_NAMES[NUM_TLB_POLICIES] = {
+    "fifo", "random", "nru", "lru"
+};
+
+bool
+TlbPolicy::Parse(const char *name, TlbPolicyKind *kind)
+{
+    ASSERT(name != nullptr);
+    ASSERT(kind != nullptr);
+
+    for (unsigned i = 0; i < NUM_TLB_POLICIES; i++) {
+        if (!strcmp(name, POLICY_NAMES[i])) {
+            *kind = (TlbPolicyKind) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+TlbPolicy::TlbPolicy(TlbPolicyKind policyKind, unsigned cpus)
+{
+    ASSERT(policyKind < NUM_TLB_POLICIES);
+    ASSERT(cpus > 0);
+
+    kind = policyKind;
+    numCpus = cpus;
+    hands = new unsigned [numCpus];
+    ages = new unsigned char [numCpus * TLB_SIZE];
+    memset(hands, 0, numCpus * sizeof *hands);
+    memset(ages, 0, numCpus * TLB_SIZE * sizeof *ages);
+}
+
+TlbPolicy::~TlbPolicy()
+{
+    delete [] hands;
+    delete [] ages;
+}
+
+const char *
+TlbPolicy::GetName() const
+{
+    return POLICY_NAMES[kind];
+}
+
+int
+TlbPolicy::FindFree(TranslationEntry *tlb)
+{
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        if (!tlb[i].valid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+unsigned
+TlbPolicy::PickNru(unsigned cpu, TranslationEntry *tlb)
+{
+    // Entries ranked from best to worst victim: not used and clean, not
+    // used and dirty, used and clean, used and dirty.
+    unsigned victim = hands[cpu];
+    unsigned best = 4;
+    for (unsigned n = 0; n < TLB_SIZE && best > 0; n++) {
+        unsigned i = (hands[cpu] + n) % TLB_SIZE;
+        unsigned rank = tlb[i].use * 2 + tlb[i].dirty;
+        if (rank < best) {
+            best = rank;
+            victim = i;
+        }
+    }
+    if (best >= 2) {
+        // Every entry was used: start telling them apart again.
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            tlb[i].use = false;
+        }
+    }
+    return victim;
+}
+
+unsigned
+TlbPolicy::PickLru(unsigned cpu, TranslationEntry *tlb)
+{
+    unsigned char *age = &ages[cpu * TLB_SIZE];
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        age[i] = (age[i] >> 1) | (tlb[i].use ? 0x80 : 0);
+        tlb[i].use = false;
+    }
+
+    unsigned victim = hands[cpu];
+    for (unsigned n = 1; n < TLB_SIZE; n++) {
+        unsigned i = (hands[cpu] + n) % TLB_SIZE;
+        if (age[i] < age[victim]) {
+            victim = i;
+        }
+    }
+    age[victim] = 0;
+    return victim;
+}
+
+unsigned
+TlbPolicy::PickVictim(unsigned cpu, TranslationEntry *tlb)
+{
+    ASSERT(cpu < numCpus);
+    ASSERT(tlb != nullptr);
+
+    int free = kind == TLB_POLICY_FIFO ? -1 : FindFree(tlb);
+    unsigned victim;
+    if (free >= 0) {
+        victim = free;
+        if (kind == TLB_POLICY_LRU) {
+            ages[cpu * TLB_SIZE + victim] = 0;
+        }
+    } else {
+        switch (kind) {
+            case TLB_POLICY_FIFO:
+                victim = hands[cpu];
+                break;
+            case TLB_POLICY_RANDOM:
+                victim = SystemDep::Random() % TLB_SIZE;
+                break;
+            case TLB_POLICY_NRU:
+                victim = PickNru(cpu, tlb);
+                break;
+            case TLB_POLICY_LRU:
+                victim = PickLru(cpu, tlb);
+                break;
+            default:
+                ASSERT(false);
+                victim = 0;
+        }
+        hands[cpu] = (victim + 1) % TLB_SIZE;
+    }
+    if (tlb[victim].valid) {
+        stats->TLBReplacements++;
+    }
+    return victim;
+}
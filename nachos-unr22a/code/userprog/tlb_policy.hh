@@ -0,0 +1,82 @@
+/// Replacement policies for the software-managed TLB.
+///
+/// On a TLB miss the kernel loads the missing translation into some entry
+/// of the TLB of the processor that missed; the policy chooses which one.
+/// The TLB gives the kernel no notice of hits, so the policies can only
+/// learn about the use of each entry from its `use` and `dirty` bits, which
+/// the hardware sets on every access.
+///
+/// * FIFO replaces entries in the order they were loaded.
+/// * Random replaces any entry.
+/// * NRU replaces an entry not used recently, clean if possible: entries
+///   are ranked by their use and dirty bits, and the use bits are cleared
+///   once every entry has been used.
+/// * Pseudo-LRU approximates the least recently used entry by aging: on
+///   every miss the use bit of each entry is shifted into a small history,
+///   and the entry with the oldest history is replaced.
+///
+/// Except for FIFO, free (invalid) entries are always taken first.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_TLBPOLICY__HH
+#define NACHOS_USERPROG_TLBPOLICY__HH
+
+
+#include "machine/translation_entry.hh"
+
+
+enum TlbPolicyKind {
+    TLB_POLICY_FIFO,
+    TLB_POLICY_RANDOM,
+    TLB_POLICY_NRU,
+    TLB_POLICY_LRU,  ///< Pseudo-LRU.
+    NUM_TLB_POLICIES
+};
+
+class TlbPolicy {
+public:
+
+    /// Find the policy called `name` (`fifo`, `random`, `nru` or `lru`).
+    ///
+    /// Returns false if there is none.
+    static bool Parse(const char *name, TlbPolicyKind *kind);
+
+    /// Manage the TLBs of `numCpus` processors with `kind`.
+    TlbPolicy(TlbPolicyKind kind, unsigned numCpus);
+
+    ~TlbPolicy();
+
+    const char *GetName() const;
+
+    /// Choose the entry of `tlb`, the TLB of processor `cpu`, to load a new
+    /// translation into, and count it in the statistics if it replaces a
+    /// valid one.
+    unsigned PickVictim(unsigned cpu, TranslationEntry *tlb);
+
+private:
+
+    /// Index of a free entry of `tlb`, or -1 if all are valid.
+    static int FindFree(TranslationEntry *tlb);
+
+    unsigned PickNru(unsigned cpu, TranslationEntry *tlb);
+
+    unsigned PickLru(unsigned cpu, TranslationEntry *tlb);
+
+    TlbPolicyKind kind;
+    unsigned numCpus;
+
+    /// Next entry to consider, per processor: the oldest one for FIFO, and
+    /// where the scan starts for NRU and pseudo-LRU, so that ties do not
+    /// always fall on the same entry.
+    unsigned *hands;
+
+    /// Use history of every entry of every TLB, for pseudo-LRU; the most
+    /// recent use is the highest bit.
+    unsigned char *ages;
+};
+
+
+#endif
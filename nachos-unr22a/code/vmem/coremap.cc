@@ -6,61 +6,406 @@
 /// limitation of liability and disclaimer of warranty provisions.
 
 #include "coremap.hh"
-#include "system.hh"
-#include <stdlib.h>
+#include "userprog/address_space.hh"
+
 #include <stdio.h>
 
-Coremap::Coremap(unsigned nitems)
+
+/// Age of a page just loaded: used in the current period only.
+static const unsigned char AGE_LOADED = 0x80;
+
+Coremap::Coremap(unsigned n)
 {
-    ASSERT(nitems > 0);
-    addressInfo = new AddressInfoEntry[nitems];
-    bitmap = new Bitmap(nitems);
-    lock = new Lock("coremapLock");
-    DEBUG('p', "Inicializando coremap\n");
-    //for(int i = 0; i < nitems; i++) {
-    //    DEBUG('p', "Inicializando coremap\n");
-    //    addressInfo[i].thread = nullptr;
-    //    addressInfo[i].vpn = -1;
-    //}
+    ASSERT(n > 0);
+
+    numFrames = n;
+    frames = new Frame[numFrames];
+    // Lowest frames first, as the bitmap this replaces used to hand them.
+    for (unsigned i = 0; i < numFrames; i++) {
+        frames[i].space    = nullptr;
+        frames[i].sharers  = nullptr;
+        frames[i].refCount = 0;
+        frames[i].vpn      = 0;
+        frames[i].pinCount = 0;
+        frames[i].state    = FRAME_FREE;
+        frames[i].cached   = false;
+        frames[i].zeroed   = false;
+        frames[i].age      = 0;
+        frames[i].prevFree = (int) i - 1;
+        frames[i].nextFree = i + 1 < numFrames ? (int) i + 1 : -1;
+    }
+    firstFree = 0;
+    lastFree = numFrames - 1;
+    numFree = numFrames;
+    numZeroed = 0;
 }
 
-/// De-allocate a bitmap.
 Coremap::~Coremap()
 {
-    delete bitmap;
-    delete lock;
-    delete [] addressInfo;
+    for (unsigned i = 0; i < numFrames; i++) {
+        if (frames[i].state != FRAME_FREE) {
+            Free(i);
+        }
+    }
+    delete [] frames;
+}
+
+void
+Coremap::Unlink(unsigned frame)
+{
+    Frame *f = &frames[frame];
+    ASSERT(f->state == FRAME_FREE);
+
+    if (f->prevFree >= 0) {
+        frames[f->prevFree].nextFree = f->nextFree;
+    } else {
+        firstFree = f->nextFree;
+    }
+    if (f->nextFree >= 0) {
+        frames[f->nextFree].prevFree = f->prevFree;
+    } else {
+        lastFree = f->prevFree;
+    }
+    numFree--;
+    if (f->zeroed) {
+        f->zeroed = false;
+        numZeroed--;
+    }
+}
+
+void
+Coremap::PushFree(unsigned frame)
+{
+    Frame *f = &frames[frame];
+    f->prevFree = -1;
+    f->nextFree = firstFree;
+    if (firstFree >= 0) {
+        frames[firstFree].prevFree = frame;
+    } else {
+        lastFree = frame;
+    }
+    firstFree = frame;
+    numFree++;
 }
 
-void 
-Coremap::Clear(unsigned which)
+void
+Coremap::AppendFree(unsigned frame)
 {
-    lock->Acquire();
-    bitmap->Clear(which);
-    lock->Release();
+    Frame *f = &frames[frame];
+    f->prevFree = lastFree;
+    f->nextFree = -1;
+    if (lastFree >= 0) {
+        frames[lastFree].nextFree = frame;
+    } else {
+        firstFree = frame;
+    }
+    lastFree = frame;
+    numFree++;
 }
+
 int
-Coremap::Find(int vpn)
+Coremap::Allocate(AddressSpace *space, unsigned vpn)
 {
-    lock->Acquire();
-    int physicalAddr = bitmap->Find();
-    if (physicalAddr == -1) {
+    ASSERT(space != nullptr);
+
+    int frame = firstFree;
+    if (frame == -1) {
         DEBUG('p', "Memory full, need to swap\n");
+    } else {
+        Unlink(frame);
+        frames[frame].space    = space;
+        frames[frame].refCount = 1;
+        frames[frame].vpn      = vpn;
+        frames[frame].state    = FRAME_LOADING;
+        frames[frame].age   = AGE_LOADED;
+    }
+    return frame;
+}
+
+int
+Coremap::AllocateZeroed(AddressSpace *space, unsigned vpn)
+{
+    ASSERT(space != nullptr);
+
+    if (numZeroed == 0) {
+        return -1;
+    }
+    // They are at the tail of the free list.
+    int frame = lastFree;
+    ASSERT(frames[frame].zeroed);
+    Unlink(frame);
+    frames[frame].space    = space;
+    frames[frame].refCount = 1;
+    frames[frame].vpn      = vpn;
+    frames[frame].state    = FRAME_LOADING;
+    frames[frame].age   = AGE_LOADED;
+    return frame;
+}
+
+void
+Coremap::Take(unsigned frame, AddressSpace *space, unsigned vpn)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(space != nullptr);
+
+    Unlink(frame);
+    frames[frame].space    = space;
+    frames[frame].refCount = 1;
+    frames[frame].vpn      = vpn;
+    frames[frame].state    = FRAME_IN_USE;
+    frames[frame].age   = AGE_LOADED;
+}
+
+void
+Coremap::SetLoaded(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    ASSERT(frames[frame].state == FRAME_LOADING);
+    frames[frame].state = FRAME_IN_USE;
+}
+
+void
+Coremap::Free(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    Frame *f = &frames[frame];
+    ASSERT(f->state != FRAME_FREE);
+    while (f->sharers != nullptr) {
+        Sharer *s = f->sharers;
+        f->sharers = s->next;
+        delete s;
+    }
+    f->space    = nullptr;
+    f->refCount = 0;
+    f->pinCount = 0;
+    f->state    = FRAME_FREE;
+    f->cached   = false;
+    f->zeroed   = false;
+    PushFree(frame);
+}
+
+void
+Coremap::Share(unsigned frame, AddressSpace *space)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(space != nullptr);
+
+    Frame *f = &frames[frame];
+    ASSERT(f->state != FRAME_FREE);
+    if (f->state == FRAME_CACHED) {
+        f->space    = space;
+        f->refCount = 1;
+        f->state    = FRAME_IN_USE;
+        return;
+    }
+    Sharer *s = new Sharer;
+    s->space = space;
+    s->next = f->sharers;
+    f->sharers = s;
+    f->refCount++;
+}
+
+void
+Coremap::Unshare(unsigned frame, AddressSpace *space)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(space != nullptr);
+
+    Frame *f = &frames[frame];
+    ASSERT(f->state != FRAME_FREE);
+    ASSERT(f->state != FRAME_CACHED);
+    if (f->refCount == 1) {
+        ASSERT(f->space == space);
+        if (f->cached) {
+            f->space    = nullptr;
+            f->refCount = 0;
+            f->state    = FRAME_CACHED;
+        } else {
+            Free(frame);
+        }
+        return;
+    }
+
+    // Si se va el dueño, el primero de los otros toma su lugar.
+    Sharer **link = &f->sharers;
+    if (f->space == space) {
+        f->space = f->sharers->space;
+    } else {
+        while ((*link)->space != space) {
+            link = &(*link)->next;
+            ASSERT(*link != nullptr);
+        }
+    }
+    Sharer *s = *link;
+    *link = s->next;
+    delete s;
+    f->refCount--;
+}
+
+void
+Coremap::SetCached(unsigned frame, bool cached)
+{
+    ASSERT(frame < numFrames);
+
+    ASSERT(frames[frame].state != FRAME_FREE);
+    frames[frame].cached = cached;
+}
+
+unsigned
+Coremap::GetRefCount(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return frames[frame].refCount;
+}
+
+AddressSpace *
+Coremap::GetSharer(unsigned frame, unsigned i) const
+{
+    ASSERT(frame < numFrames);
+    ASSERT(i < frames[frame].refCount);
+
+    if (i == 0) {
+        return frames[frame].space;
+    }
+    const Sharer *s = frames[frame].sharers;
+    for (; i > 1; i--) {
+        s = s->next;
+    }
+    return s->space;
+}
+
+void
+Coremap::Pin(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    ASSERT(frames[frame].state != FRAME_FREE);
+    frames[frame].pinCount++;
+}
+
+void
+Coremap::Unpin(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    ASSERT(frames[frame].pinCount > 0);
+    frames[frame].pinCount--;
+}
+
+bool
+Coremap::IsEvictable(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return (frames[frame].state == FRAME_IN_USE
+              || frames[frame].state == FRAME_CACHED)
+           && frames[frame].pinCount == 0;
+}
+
+unsigned
+Coremap::CountFree() const
+{
+    return numFree;
+}
+
+int
+Coremap::FindUnzeroed() const
+{
+    // They are at the head of the free list.
+    if (numFree == numZeroed) {
+        return -1;
     }
-    lock->Release();
-    return physicalAddr;
+    ASSERT(!frames[firstFree].zeroed);
+    return firstFree;
+}
+
+void
+Coremap::SetZeroed(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    Frame *f = &frames[frame];
+    ASSERT(f->state == FRAME_FREE);
+    ASSERT(!f->zeroed);
+    Unlink(frame);
+    AppendFree(frame);
+    f->zeroed = true;
+    numZeroed++;
+}
+
+unsigned
+Coremap::CountZeroed() const
+{
+    return numZeroed;
+}
+
+void
+Coremap::ForgetZeroed()
+{
+    for (unsigned i = 0; i < numFrames; i++) {
+        frames[i].zeroed = false;
+    }
+    numZeroed = 0;
+}
+
+AddressSpace *
+Coremap::GetOwner(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return frames[frame].space;
+}
+
+unsigned
+Coremap::GetVpn(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return frames[frame].vpn;
+}
+
+TranslationEntry *
+Coremap::GetPageEntry(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    ASSERT(frames[frame].space != nullptr);
+    return &frames[frame].space->GetPageTable()->Find(frames[frame].vpn)->translation;
+}
+
+FrameState
+Coremap::GetState(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return frames[frame].state;
+}
+
+void
+Coremap::Age(unsigned frame, bool referenced)
+{
+    ASSERT(frame < numFrames);
+    frames[frame].age = (frames[frame].age >> 1) | (referenced ? 0x80 : 0);
 }
 
 unsigned
-Coremap::CountClear() const
+Coremap::GetAge(unsigned frame) const
 {
-    lock->Acquire();
-    return bitmap->CountClear();
-    lock->Release();
+    ASSERT(frame < numFrames);
+    return frames[frame].age;
 }
 
 void
 Coremap::Print() const
 {
-    bitmap->Print();
+    printf("Coremap: %u of %u frames free, %u of them zeroed\n",
+           numFree, numFrames, numZeroed);
+    for (unsigned i = 0; i < numFrames; i++) {
+        const Frame *f = &frames[i];
+        if (f->state != FRAME_FREE) {
+            printf("    frame %u: space %p, vpn %u, %s, pinned %u,"
+                   " shared by %u\n",
+                   i, (void *) f->space, f->vpn,
+                   f->state == FRAME_LOADING ? "loading"
+                     : f->state == FRAME_CACHED ? "cached" : "in use",
+                   f->pinCount, f->refCount);
+        }
+    }
 }
\ No newline at end of file
@@ -1,12 +1,31 @@
-/// A data structure defining a bitmap -- an array of bits each of which can
-/// be either on or off.  It is also known as a bit array, bit set or bit
-/// vector.
+/// Data structures to keep track of the physical frames.
 ///
-/// The bitmap is represented as an array of unsigned integers, on which we
-/// do modulo arithmetic to find the bit we are interested in.
+/// The coremap has a descriptor for every frame of physical memory: which
+/// address space and virtual page it holds, whether it is free, being
+/// loaded or in use, and how many times it is pinned.  It is the reverse of
+/// the page tables: replacement policies look up the page held by a frame
+/// here, without going through the threads that own the pages.
 ///
-/// The data structure is parameterized with with the number of bits being
-/// managed.
+/// Free frames are linked in a list threaded through their descriptors,
+/// so taking and returning a frame, and counting the free ones, take
+/// constant time however big physical memory is.  Free frames already
+/// filled with zeros are kept at the tail of the list, apart from the rest,
+/// for pages that start out empty.
+///
+/// A frame can be shared by several address spaces, after a `Fork`, until
+/// each of them but one writes the page and gets a copy of its own.  The
+/// frame keeps how many spaces map it and which; all of them map it at the
+/// same virtual page, the one it was taken for.
+///
+/// Frames that hold a page of the page cache are shared the same way by
+/// every space running the executable.  When the last of them lets such a
+/// frame go it is not freed but kept, cached, so that the next process that
+/// runs the executable finds the page already in memory.  A cached frame
+/// can be evicted like any page in use.
+///
+/// No operation blocks or enables interrupts, so each is atomic by itself
+/// and needs no lock; callers that look up a frame and then change it, as
+/// when choosing a victim, keep others out with `usedPagesLock`.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -19,52 +38,157 @@
 
 
 #include "lib/utility.hh"
-#include "filesys/open_file.hh"
-#include "lib/bitmap.hh"
-#include "threads/thread.hh"
-#include "threads/lock.hh"
-
-class AddressInfoEntry {
-    public: 
-        unsigned vpn = 0;
-        Thread *thread = nullptr;
-        bool loading = false;
-        AddressInfoEntry() : vpn(-1), thread(nullptr), loading(false) {}
+#include "machine/translation_entry.hh"
+
+
+class AddressSpace;
+
+enum FrameState {
+    FRAME_FREE,
+    FRAME_LOADING,  ///< Taken, but its page is still being read or the
+                    ///< previous one written out.
+    FRAME_IN_USE,
+    FRAME_CACHED    ///< Holds a page of the page cache that no address
+                    ///< space maps.
 };
 
 class Coremap {
 public:
 
-    /// Initialize a bitmap with `nitems` bits; all bits are cleared.
-    ///
-    /// * `nitems` is the number of items in the bitmap.
-    Coremap(unsigned nitems);
+    /// Initialize a coremap of `numFrames` frames, all free.
+    Coremap(unsigned numFrames);
 
-    /// Uninitialize a bitmap.
     ~Coremap();
 
-    /// Clear the “nth” bit.
-    void Clear(unsigned which);
+    /// Take a free frame for page `vpn` of `space`.  The frame is left
+    /// loading, until `SetLoaded` is called.  Frames filled with zeros are
+    /// taken only if there are no others.
+    ///
+    /// Returns the frame, or -1 if there are no free frames.
+    int Allocate(AddressSpace *space, unsigned vpn);
 
-    /// Return the index of a clear bit, and as a side effect, set the bit.
+    /// Like `Allocate`, but take a free frame filled with zeros.
     ///
-    /// If no bits are clear, return -1.
-    int Find(int vpn);
+    /// Returns the frame, or -1 if there are none.
+    int AllocateZeroed(AddressSpace *space, unsigned vpn);
 
-    /// Return the number of clear bits.
-    unsigned CountClear() const;
+    /// Take the free frame `frame` for page `vpn` of `space`, in use.
+    void Take(unsigned frame, AddressSpace *space, unsigned vpn);
 
-    /// Print contents of bitmap.
-    void Print() const;
+    /// The page of `frame` is loaded.
+    void SetLoaded(unsigned frame);
 
-    AddressInfoEntry *addressInfo; 
-private:
+    /// Return `frame` to the free frames, whoever maps it.
+    void Free(unsigned frame);
+
+    /// Page `vpn` of `space` maps `frame` too, besides the spaces that
+    /// already did.  If the frame is cached, `space` becomes its owner.
+    void Share(unsigned frame, AddressSpace *space);
+
+    /// `space` does not map `frame` any more.  The frame is freed when the
+    /// last space that mapped it lets it go, or left cached if it was kept
+    /// with `SetCached`.
+    void Unshare(unsigned frame, AddressSpace *space);
+
+    /// Whether to keep `frame` cached when no space maps it any more.
+    /// Freeing the frame forgets it.
+    void SetCached(unsigned frame, bool cached);
+
+    /// Number of address spaces that map `frame`.
+    unsigned GetRefCount(unsigned frame) const;
+
+    /// The `i`-th address space that maps `frame`, counting from 0, which
+    /// is its owner.
+    AddressSpace *GetSharer(unsigned frame, unsigned i) const;
+
+    /// Keep `frame` from being evicted until it is unpinned as many times.
+    void Pin(unsigned frame);
 
-    Bitmap * bitmap;
+    void Unpin(unsigned frame);
 
-    Lock *lock;
+    /// Whether `frame` holds a page that can be evicted: it is in use or
+    /// cached, and not pinned.
+    bool IsEvictable(unsigned frame) const;
 
+    unsigned CountFree() const;
 
+    /// Return a free frame not filled with zeros, or -1 if there are none.
+    int FindUnzeroed() const;
+
+    /// The free frame `frame` was filled with zeros.
+    void SetZeroed(unsigned frame);
+
+    /// Number of free frames filled with zeros.
+    unsigned CountZeroed() const;
+
+    /// Free frames do not hold zeros any more: physical memory was
+    /// overwritten.
+    void ForgetZeroed();
+
+    /// Reverse map: the address space whose page `frame` holds, or null if
+    /// it is free or cached.  If the frame is shared, the first of the spaces that
+    /// map it.
+    AddressSpace *GetOwner(unsigned frame) const;
+
+    /// Reverse map: the virtual page `frame` holds.
+    unsigned GetVpn(unsigned frame) const;
+
+    /// Reverse map: the page table entry of the page `frame` holds, in the
+    /// page table of its owner.
+    TranslationEntry *GetPageEntry(unsigned frame) const;
+
+    FrameState GetState(unsigned frame) const;
+
+    /// Shift `referenced` into the age of `frame`, as its most recent bit.
+    ///
+    /// The age keeps whether the page was used in each of the last few
+    /// periods: the lower it is, the longer ago the page was last used.
+    void Age(unsigned frame, bool referenced);
+
+    unsigned GetAge(unsigned frame) const;
+
+    /// Print the descriptor of every frame not free.
+    void Print() const;
+
+private:
+
+    /// The other address spaces that map a shared frame, besides its
+    /// owner.
+    struct Sharer {
+        AddressSpace *space;
+        Sharer *next;
+    };
+
+    struct Frame {
+        AddressSpace *space;
+        Sharer *sharers;
+        unsigned refCount;
+        unsigned vpn;
+        unsigned pinCount;
+        FrameState state;
+        bool cached;  ///< Kept cached when the last space lets it go.
+        bool zeroed;  ///< Free and filled with zeros.
+        unsigned char age;
+        int prevFree;  ///< Neighbours in the free list, -1 at its ends.
+        int nextFree;
+    };
+
+    /// Unlink the free frame `frame` from the free list.
+    void Unlink(unsigned frame);
+
+    /// Link the free frame `frame` at the head of the free list, or at its
+    /// tail.
+    void PushFree(unsigned frame);
+    void AppendFree(unsigned frame);
+
+    Frame *frames;
+    unsigned numFrames;
+
+    int firstFree;  ///< Head of the free list, -1 if empty.
+    int lastFree;   ///< Tail of the free list, -1 if empty.
+    unsigned numFree;
+    unsigned numZeroed;  ///< Free frames filled with zeros.
 };
 
+
 #endif
@@ -0,0 +1,93 @@
+/// Routines to manage the page cache.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_cache.hh"
+#include "lib/utility.hh"
+
+
+PageCache::PageCache(unsigned n)
+{
+    ASSERT(n > 0);
+
+    numFrames = n;
+    entries = new Entry[numFrames];
+    buckets = new int[numFrames];
+    for (unsigned i = 0; i < numFrames; i++) {
+        entries[i].inUse = false;
+        entries[i].next = -1;
+        buckets[i] = -1;
+    }
+}
+
+PageCache::~PageCache()
+{
+    delete [] entries;
+    delete [] buckets;
+}
+
+unsigned
+PageCache::Hash(unsigned file, unsigned page) const
+{
+    // The pages of an executable are consecutive, so they spread over
+    // consecutive buckets.
+    return (file * 31 + page) % numFrames;
+}
+
+int
+PageCache::Find(unsigned file, unsigned version, unsigned page) const
+{
+    for (int frame = buckets[Hash(file, page)]; frame != -1;
+         frame = entries[frame].next) {
+        if (entries[frame].file == file && entries[frame].version == version
+              && entries[frame].page == page) {
+            return frame;
+        }
+    }
+    return -1;
+}
+
+void
+PageCache::Insert(unsigned file, unsigned version, unsigned page,
+                  unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(!entries[frame].inUse);
+    ASSERT(Find(file, version, page) == -1);
+
+    unsigned bucket = Hash(file, page);
+    entries[frame].file    = file;
+    entries[frame].version = version;
+    entries[frame].page    = page;
+    entries[frame].inUse   = true;
+    entries[frame].next    = buckets[bucket];
+    buckets[bucket] = frame;
+}
+
+void
+PageCache::Remove(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    if (!entries[frame].inUse) {
+        return;
+    }
+    int *link = &buckets[Hash(entries[frame].file, entries[frame].page)];
+    while (*link != (int) frame) {
+        ASSERT(*link != -1);
+        link = &entries[*link].next;
+    }
+    *link = entries[frame].next;
+    entries[frame].inUse = false;
+    entries[frame].next  = -1;
+}
+
+bool
+PageCache::Contains(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return entries[frame].inUse;
+}
@@ -0,0 +1,74 @@
+/// Data structures to share the code pages of an executable between the
+/// processes that run it.
+///
+/// The page cache maps a page of an executable, named by the sector of the
+/// file header of the executable and the index of the page, to the frame
+/// that holds it.  Only pages made entirely of code go in: they are read
+/// only, so every address space running the executable can map the same
+/// frame, and they never need to be written back.
+///
+/// Cached frames outlive the processes that loaded them, and by then the
+/// executable may have been written, or removed and its sector given to
+/// another file.  So each entry also keeps the version of the file it was
+/// read from, and only a lookup with the same version finds it.  Stale
+/// entries are not removed: they go away as their frames get reused.
+///
+/// A frame holds at most one page, so the cache keeps one entry per frame,
+/// chained from a table of buckets by hashing the page.  It does not pin
+/// the frames it names: whoever frees or reuses a frame has to `Remove` it
+/// first.
+///
+/// The cache is not protected here: callers keep each other out with
+/// `usedPagesLock`, as they do for the coremap.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#ifndef NACHOS_VMEM_PAGECACHE__HH
+#define NACHOS_VMEM_PAGECACHE__HH
+
+
+class PageCache {
+public:
+
+    /// Initialize an empty cache for `numFrames` frames.
+    PageCache(unsigned numFrames);
+
+    ~PageCache();
+
+    /// Return the frame that holds page `page` of version `version` of the
+    /// executable whose file header is at `file`, or -1 if it is not in
+    /// the cache.
+    int Find(unsigned file, unsigned version, unsigned page) const;
+
+    /// `frame` holds page `page` of version `version` of the executable
+    /// `file`, which must not be in the cache yet.
+    void Insert(unsigned file, unsigned version, unsigned page, unsigned frame);
+
+    /// Take `frame` out of the cache, if it is in it.
+    void Remove(unsigned frame);
+
+    /// Whether `frame` is in the cache.
+    bool Contains(unsigned frame) const;
+
+private:
+
+    struct Entry {
+        unsigned file;
+        unsigned version;
+        unsigned page;
+        bool inUse;
+        int next;  ///< Next frame in the same bucket, -1 at the end.
+    };
+
+    unsigned Hash(unsigned file, unsigned page) const;
+
+    Entry *entries;  ///< Indexed by frame.
+    int *buckets;    ///< First frame of each bucket, -1 if empty.
+    unsigned numFrames;
+};
+
+
+#endif
@@ -0,0 +1,131 @@
+/// Routines to manage a swap partition.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_partition.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+SwapPartition::SwapPartition(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    // Nothing in the image outlives the run that swapped it.
+    SystemDep::Unlink(name);
+    disk = new SynchDisk(name);
+
+    sectorsPerSlot = DivRoundUp(PAGE_SIZE, SECTOR_SIZE);
+    numSlots = NUM_SECTORS / sectorsPerSlot;
+    ASSERT(numSlots > 0);
+    slots = new Bitmap(numSlots);
+    numFree = numSlots;
+}
+
+SwapPartition::~SwapPartition()
+{
+    delete slots;
+    delete disk;
+}
+
+int
+SwapPartition::AllocateSlot()
+{
+    int slot = slots->Find();
+    if (slot == -1) {
+        DEBUG('p', "Swap partition full\n");
+    } else {
+        numFree--;
+    }
+    return slot;
+}
+
+void
+SwapPartition::FreeSlot(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(slots->Test(slot));
+    slots->Clear(slot);
+    numFree++;
+}
+
+unsigned
+SwapPartition::CountFree() const
+{
+    return numFree;
+}
+
+void
+SwapPartition::WritePage(unsigned slot, const char *page)
+{
+    TransferOut(slot, page, true);
+}
+
+void
+SwapPartition::ReadPage(unsigned slot, char *page)
+{
+    TransferIn(slot, page, true);
+}
+
+void
+SwapPartition::WritePageUntimed(unsigned slot, const char *page)
+{
+    TransferOut(slot, page, false);
+}
+
+void
+SwapPartition::ReadPageUntimed(unsigned slot, char *page)
+{
+    TransferIn(slot, page, false);
+}
+
+void
+SwapPartition::TransferOut(unsigned slot, const char *page, bool timed)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(page != nullptr);
+
+    unsigned first = slot * sectorsPerSlot;
+    char sector[SECTOR_SIZE];
+    for (unsigned i = 0; i < sectorsPerSlot; i++) {
+        const char *data = page + i * SECTOR_SIZE;
+        if (PAGE_SIZE < SECTOR_SIZE) {
+            // Only a page fits in the slot anyway; the rest of the sector
+            // is left blank.
+            memcpy(sector, page, PAGE_SIZE);
+            memset(sector + PAGE_SIZE, 0, SECTOR_SIZE - PAGE_SIZE);
+            data = sector;
+        }
+        if (timed) {
+            disk->WriteSector(first + i, data);
+        } else {
+            disk->WriteSectorUntimed(first + i, data);
+        }
+    }
+}
+
+void
+SwapPartition::TransferIn(unsigned slot, char *page, bool timed)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(page != nullptr);
+
+    unsigned first = slot * sectorsPerSlot;
+    char sector[SECTOR_SIZE];
+    for (unsigned i = 0; i < sectorsPerSlot; i++) {
+        char *data = PAGE_SIZE < SECTOR_SIZE ? sector : page + i * SECTOR_SIZE;
+        if (timed) {
+            disk->ReadSector(first + i, data);
+        } else {
+            disk->ReadSectorUntimed(first + i, data);
+        }
+        if (PAGE_SIZE < SECTOR_SIZE) {
+            memcpy(page, sector, PAGE_SIZE);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/// Data structures to keep evicted pages in a swap partition.
+///
+/// The swap partition is a simulated disk of its own, split in slots of as
+/// many sectors as it takes to hold a page.  A bitmap keeps track of the
+/// slots in use, and every address space remembers the slot of each of its
+/// pages that was swapped out.  Pages are read and written with sector I/O
+/// straight to the disk, so creating a process or swapping a page does not
+/// go through the file system.
+///
+/// The slot bitmap is not protected here: callers keep each other out with
+/// `usedPagesLock`, as they do for the coremap.
+///
+/// Copyright (c) 2022 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#ifndef NACHOS_VMEM_SWAPPARTITION__HH
+#define NACHOS_VMEM_SWAPPARTITION__HH
+
+
+#include "filesys/synch_disk.hh"
+#include "lib/bitmap.hh"
+
+
+class SwapPartition {
+public:
+
+    /// Create an empty swap partition on the disk image `name`, discarding
+    /// whatever a previous run left in it.
+    SwapPartition(const char *name);
+
+    ~SwapPartition();
+
+    /// Take a free slot.
+    ///
+    /// Returns the slot, or -1 if the partition is full.
+    int AllocateSlot();
+
+    void FreeSlot(unsigned slot);
+
+    unsigned CountFree() const;
+
+    /// Write the page at `page` to `slot`, or read it back.  Both wait until
+    /// the disk is done.
+
+    void WritePage(unsigned slot, const char *page);
+    void ReadPage(unsigned slot, char *page);
+
+    /// The same, but outside simulated time and without counting disk I/O,
+    /// so that saving or restoring a checkpoint does not change the run.
+
+    void WritePageUntimed(unsigned slot, const char *page);
+    void ReadPageUntimed(unsigned slot, char *page);
+
+private:
+    SynchDisk *disk;
+    Bitmap *slots;  ///< Slots in use.
+    unsigned numSlots;
+    unsigned numFree;  ///< Slots clear in `slots`, counted as they change.
+    unsigned sectorsPerSlot;
+
+    void TransferOut(unsigned slot, const char *page, bool timed);
+    void TransferIn(unsigned slot, char *page, bool timed);
+};
+
+
+#endif